@@ -2,8 +2,21 @@
 
 #include "MiniSQLBufferManager.h"
 #include "MiniSQLException.h"
+#include <memory>
+#include <vector>
+#include <functional>
+#include <algorithm>
 
 #define META_PAGE_ID 0
+#define LEAF_READ_AHEAD 8   //ҶʱҶԤĿ
+
+//ҳеĲ֣isLeaf keyNum prevLeaf nextLeaf key[rank+1] child[rank+1] data[rank+1]У
+//ֶβһ룬ֻmemcpyд
+#define NODE_ISLEAF_OFFSET 0
+#define NODE_KEYNUM_OFFSET 1
+#define NODE_PREVLEAF_OFFSET 5
+#define NODE_NEXTLEAF_OFFSET 9
+#define NODE_HEADER_SIZE 13
 
 /*                                          */
 /*                  쳣                    */
@@ -33,73 +46,80 @@ public:
     /*                                          */
     /*                                          */
 
+    //α꣺סǰҶҳ²ۺţֵ۴ҳȡ
+    //nextLeafǰҶҲڴ档絽һҶʱԤҶ
     class iter {
     public:
         iter(const NodeType *node, int offset) {
+            ahead = 0;
             if (node == nullptr) {
+                buffer = nullptr;
+                file = 0;
+                rank = 0;
                 self = 0;
                 this->offset = 0;
-                key = nullptr;
-                data = nullptr;
                 return;
             }
-            if (!(node->isLeaf)) throw BPlusTreeException::IteratorIllegal;
+            if (!node->isLeaf()) throw BPlusTreeException::IteratorIllegal;
 
             buffer = node->buffer;
-            filename = node->filename;
+            file = node->file;
             self = node->self;
             rank = node->rank;
-            keyNum = node->keyNum;
-            nextLeaf = node->nextLeaf;
-
-            key = new KeyType[rank + 1];
-            data = new DataType[rank + 1];
-            for (int i = 0; i < keyNum; i++) {
-                key[i] = node->key[i];
-                data[i] = node->data[i];
-            }
+            page = buffer->fetchPage(file, self, PageIntent::READ_ONLY);
             this->offset = offset;
         }
         iter(const iter &rhs)
-            : buffer(rhs.buffer), filename(rhs.filename), self(rhs.self), rank(rhs.rank), keyNum(rhs.keyNum), nextLeaf(rhs.nextLeaf), offset(rhs.offset)
+            : buffer(rhs.buffer), file(rhs.file), self(rhs.self), rank(rhs.rank), offset(rhs.offset), ahead(rhs.ahead)
         {
-            if (self == 0) {
-                key = nullptr;
-                data = nullptr;
-                return;
-            }
-            key = new KeyType[rank + 1];
-            data = new DataType[rank + 1];
-            for (int i = 0; i < keyNum; i++) {
-                key[i] = rhs.key[i];
-                data[i] = rhs.data[i];
-            }
+            if (self != 0) page = buffer->fetchPage(file, self, PageIntent::READ_ONLY);
         };
-        ~iter() { if (key != nullptr) delete[] key; if (data != nullptr) delete[] data; }
+        iter(iter &&rhs)
+            : buffer(rhs.buffer), file(rhs.file), self(rhs.self), rank(rhs.rank), page(std::move(rhs.page)), offset(rhs.offset), ahead(rhs.ahead)
+        {
+            rhs.self = 0;
+            rhs.offset = 0;
+        }
+        iter &operator=(const iter &rhs) {
+            if (this != &rhs) {
+                buffer = rhs.buffer;
+                file = rhs.file;
+                self = rhs.self;
+                rank = rhs.rank;
+                offset = rhs.offset;
+                ahead = rhs.ahead;
+                page = (self != 0) ? buffer->fetchPage(file, self, PageIntent::READ_ONLY) : PageGuard();
+            }
+            return *this;
+        }
 
         bool valid() const { return (self != 0); }
         void next() {
             if (!valid()) throw BPlusTreeException::IteratorOverBounds;
-            if (offset < keyNum - 1) offset++;
-            else if (nextLeaf) {
-                NodeType nextNode(buffer, filename, nextLeaf, rank);
-                self = nextNode.self;
-                keyNum = nextNode.keyNum;
-                nextLeaf = nextNode.nextLeaf;
-                for (int i = 0; i < keyNum; i++) {
-                    key[i] = nextNode.key[i];
-                    data[i] = nextNode.data[i];
-                }
-                offset = 0;
-            } else {
-                self = 0;
+            if (++offset < NodeType::keyNumOf(page.data())) return;
+            //һǿҶ
+            int nextLeaf = NodeType::nextLeafOf(page.data());
+            while (nextLeaf) {
+                page = buffer->fetchPage(file, nextLeaf, PageIntent::READ_ONLY);
+                self = nextLeaf;
                 offset = 0;
+                readAhead();
+                if (NodeType::keyNumOf(page.data()) > 0) return;
+                nextLeaf = NodeType::nextLeafOf(page.data());
             }
+            page.release();
+            self = 0;
+            offset = 0;
         }
-        std::pair<KeyType, DataType> operator*() const {
+        KeyType key() const {
             if (!valid()) throw BPlusTreeException::IteratorOverBounds;
-            return make_pair(key[offset], data[offset]);
+            return NodeType::keyOf(page.data(), offset);
         }
+        DataType value() const {
+            if (!valid()) throw BPlusTreeException::IteratorOverBounds;
+            return NodeType::dataOf(page.data(), rank, offset);
+        }
+        std::pair<KeyType, DataType> operator*() const { return make_pair(key(), value()); }
 
         bool operator==(const iter &rhs) const {
             return (self == rhs.self && offset == rhs.offset);
@@ -108,39 +128,45 @@ public:
 
     private:
         BufferManager *buffer;
-        string filename;
+        int file;
         int self;
         int rank;
 
-        int keyNum;
-        KeyType *key;
-        DataType *data;
-        int nextLeaf;
+        PageGuard page;
         int offset;
+        int ahead;//ԤʱԤһ
+
+        //ҶӽŴţĽʱԤһΣֻԤһҶ
+        void readAhead() {
+            int following = NodeType::nextLeafOf(page.data());
+            if (following == 0 || (following > self && following < ahead)) return;
+            if (following == self + 1) {
+                buffer->prefetch(file, following, LEAF_READ_AHEAD);
+                ahead = following + LEAF_READ_AHEAD / 2;
+            }
+            else buffer->prefetch(file, following, 1);
+        }
     };
 
-    BPlusNode(BufferManager *buffer, const string& filename, int self, int rank, bool isLeaf)
-        : buffer(buffer), filename(filename), self(self), rank(rank), isLeaf(isLeaf), keyNum(0), prevLeaf(0), nextLeaf(0)
-        , key(new KeyType[rank + 1]), child(new int[rank + 1]), data(new DataType[rank + 1]) {}
-    BPlusNode(BufferManager *buffer, const string& filename, int rank, int self);
+    BPlusNode(BufferManager *buffer, int file, int self, int rank, bool isLeaf);
+    //еĽ㣬ֻĽ㣨constPageIntent::READ_ONLYȡҳ
+    BPlusNode(BufferManager *buffer, int file, int self, int rank, PageIntent intent = PageIntent::READ);
     BPlusNode(const BPlusNode &) = delete;
-    ~BPlusNode() { delete[] key; delete[] child; delete[] data; }
-
-    void writeBackToBuffer();
+    ~BPlusNode() = default;
 
     int findNextPath(const KeyType &guideKey) const;
     int splitNode(NodeType *parentNode);
     /*void print() const {
-        if (isLeaf) {
-            std::cout << this->keyNum << "-Leaf:";
-            for (int i = 0; i < this->keyNum; i++) std::cout << "[" << this->key[i] << "," << data[i] << "]";
+        if (isLeaf()) {
+            std::cout << getKeyNum() << "-Leaf:";
+            for (int i = 0; i < getKeyNum(); i++) std::cout << "[" << getKey(i) << "," << getData(i) << "]";
             std::cout << std::endl;
         } else {
-            std::cout << this->keyNum << "-Internal:";
-            for (int i = 0; i < this->keyNum; i++) std::cout << "[" << this->key[i] << "]";
+            std::cout << getKeyNum() << "-Internal:";
+            for (int i = 0; i < getKeyNum(); i++) std::cout << "[" << getKey(i) << "]";
             std::cout << std::endl;
-            for (int i = 0; i <= this->keyNum; i++) {
-                const NodeType childNode(buffer, filename, child[i], rank);
+            for (int i = 0; i <= getKeyNum(); i++) {
+                const NodeType childNode(buffer, file, getChild(i), rank, PageIntent::READ_ONLY);
                 childNode.print();
             }
         }
@@ -169,18 +195,52 @@ private:
     iter getStart_leaf(const KeyType &guideKey, bool canEqual) const;
     iter getStart_intern(const KeyType &guideKey, bool canEqual) const;
 
+    //ֱҳ޸ģĹ֮ҳ
+    void markDirty() { page.markDirty(); }
+
+    //ҳеֶβһ룬һmemcpyд
+    template<typename T>
+    static T load(const char *src) {
+        T value;
+        memcpy_s(&value, sizeof(T), src, sizeof(T));
+        return value;
+    }
+    template<typename T>
+    static void store(char *dst, const T &value) { memcpy_s(dst, sizeof(T), &value, sizeof(T)); }
+
+    //ҳеĲֶελ
+    static int keyOffset(int i) { return NODE_HEADER_SIZE + i * sizeof(KeyType); }
+    static int childOffset(int rank, int i) { return keyOffset(rank + 1) + i * sizeof(int); }
+    static int dataOffset(int rank, int i) { return childOffset(rank, rank + 1) + i * sizeof(DataType); }
+
+    //ֻҳֱӰҳ
+    static int keyNumOf(const char *head) { return load<int>(head + NODE_KEYNUM_OFFSET); }
+    static int nextLeafOf(const char *head) { return load<int>(head + NODE_NEXTLEAF_OFFSET); }
+    static KeyType keyOf(const char *head, int i) { return load<KeyType>(head + keyOffset(i)); }
+    static DataType dataOf(const char *head, int rank, int i) { return load<DataType>(head + dataOffset(rank, i)); }
+
+    bool isLeaf() const { return load<bool>(page.data() + NODE_ISLEAF_OFFSET); }
+    int getKeyNum() const { return keyNumOf(page.data()); }
+    int getPrevLeaf() const { return load<int>(page.data() + NODE_PREVLEAF_OFFSET); }
+    int getNextLeaf() const { return nextLeafOf(page.data()); }
+    KeyType getKey(int i) const { return keyOf(page.data(), i); }
+    int getChild(int i) const { return load<int>(page.data() + childOffset(rank, i)); }
+    DataType getData(int i) const { return dataOf(page.data(), rank, i); }
+
+    void setLeaf(bool leaf) { store(page.data() + NODE_ISLEAF_OFFSET, leaf); }
+    void setKeyNum(int num) { store(page.data() + NODE_KEYNUM_OFFSET, num); }
+    void setPrevLeaf(int block) { store(page.data() + NODE_PREVLEAF_OFFSET, block); }
+    void setNextLeaf(int block) { store(page.data() + NODE_NEXTLEAF_OFFSET, block); }
+    void setKey(int i, const KeyType &k) { store(page.data() + keyOffset(i), k); }
+    void setChild(int i, int block) { store(page.data() + childOffset(rank, i), block); }
+    void setData(int i, const DataType &d) { store(page.data() + dataOffset(rank, i), d); }
+
     BufferManager *buffer;
-    const string filename;
+    const int file;
     int self;
     const int rank;
 
-    bool isLeaf;
-    int keyNum;
-    KeyType *key;
-    int *child;
-    DataType *data;
-    int nextLeaf;
-    int prevLeaf;
+    PageGuard page;//ҳڼһֱס
 
     friend class BPlusTree<KeyType, DataType>;
 };
@@ -189,99 +249,71 @@ private:
 /*                  ʵ                    */
 /*                                          */
 
+//½㣨ڿallocNewBlock䣩
 template<typename KeyType, typename DataType>
-BPlusNode<KeyType, DataType>::BPlusNode(BufferManager *buffer, const string& filename, int self, int rank)
-    : buffer(buffer), filename(filename), self(self), rank(rank), key(new KeyType[rank + 1]), child(new int[rank + 1]), data(new DataType[rank + 1])
+BPlusNode<KeyType, DataType>::BPlusNode(BufferManager *buffer, int file, int self, int rank, bool isLeaf)
+    : buffer(buffer), file(file), self(self), rank(rank), page(buffer->fetchPage(file, self, PageIntent::WRITE))
 {
-    char *nodeBuffer = buffer->getBlockContent(filename, self);
-
-    int p = 0;
-    memcpy_s(&isLeaf, sizeof(isLeaf), nodeBuffer + p, sizeof(isLeaf));
-    p += sizeof(isLeaf);
-    memcpy_s(&keyNum, sizeof(keyNum), nodeBuffer + p, sizeof(keyNum));
-    p += sizeof(keyNum);
-    memcpy_s(&prevLeaf, sizeof(prevLeaf), nodeBuffer + p, sizeof(prevLeaf));
-    p += sizeof(prevLeaf);
-    memcpy_s(&nextLeaf, sizeof(nextLeaf), nodeBuffer + p, sizeof(nextLeaf));
-    p += sizeof(nextLeaf);
-    memcpy_s(key, sizeof(key[0]) * (rank + 1), nodeBuffer + p, sizeof(key[0]) * (rank + 1));
-    p += sizeof(key[0]) * (rank + 1);
-    memcpy_s(child, sizeof(child[0]) * (rank + 1), nodeBuffer + p, sizeof(child[0]) * (rank + 1));
-    p += sizeof(child[0]) * (rank + 1);
-    memcpy_s(data, sizeof(data[0]) * (rank + 1), nodeBuffer + p, sizeof(data[0]) * (rank + 1));
-    p += sizeof(data[0]) * (rank + 1);
+    setLeaf(isLeaf);
+    setKeyNum(0);
+    setPrevLeaf(0);
+    setNextLeaf(0);
 }
 
 template<typename KeyType, typename DataType>
-void BPlusNode<KeyType, DataType>::writeBackToBuffer() {
-    if (self == 0) return;
-
-    int p = 0;
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(&isLeaf), sizeof(isLeaf));
-    p += sizeof(isLeaf);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(&keyNum), sizeof(keyNum));
-    p += sizeof(keyNum);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(&prevLeaf), sizeof(prevLeaf));
-    p += sizeof(prevLeaf);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(&nextLeaf), sizeof(nextLeaf));
-    p += sizeof(nextLeaf);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(key), sizeof(key[0]) * (rank + 1));
-    p += sizeof(key[0]) * (rank + 1);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(child), sizeof(child[0]) * (rank + 1));
-    p += sizeof(child[0]) * (rank + 1);
-    buffer->setBlockContent(filename, self, p, reinterpret_cast<char*>(data), sizeof(data[0]) * (rank + 1));
-    p += sizeof(data[0]) * (rank + 1);
-}
+BPlusNode<KeyType, DataType>::BPlusNode(BufferManager *buffer, int file, int self, int rank, PageIntent intent)
+    : buffer(buffer), file(file), self(self), rank(rank), page(buffer->fetchPage(file, self, intent))
+{}
 
 template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::findNextPath(const KeyType &guideKey) const {
-    int left = 0, right = keyNum - 1;
+    int left = 0, right = getKeyNum() - 1;
     while (left != right) {
         int mid = (left + right) / 2;
-        if (guideKey < key[mid]) right = mid;
+        if (guideKey < getKey(mid)) right = mid;
         else left = mid + 1;
     }
-    if (guideKey >= key[right]) right++;
+    if (guideKey >= getKey(right)) right++;
     return right;
 }
 
 template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::splitNode(NodeType *parentNode) {
-    if (isLeaf) return splitNode_leaf(parentNode);
+    if (isLeaf()) return splitNode_leaf(parentNode);
     else return splitNode_intern(parentNode);
 }
 
 template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::splitNode_leaf(NodeType *parentNode) {
     int retval = 0;
+    int keyNum = getKeyNum();
     int leftKeyNum = keyNum / 2;
 
-    int newBlock = buffer->allocNewBlock(filename);
-    NodeType newNode(buffer, filename, newBlock, rank, true);
+    int newBlock = buffer->allocNewBlock(file);
+    NodeType newNode(buffer, file, newBlock, rank, true);
 
-    if (this->nextLeaf) {
-        NodeType nextNode(buffer, filename, nextLeaf, rank);
-        nextNode.prevLeaf = newBlock;
-        nextNode.writeBackToBuffer();
+    if (getNextLeaf()) {
+        NodeType nextNode(buffer, file, getNextLeaf(), rank);
+        nextNode.setPrevLeaf(newBlock);
+        nextNode.markDirty();
     }
 
-    newNode.nextLeaf = nextLeaf;
-    newNode.prevLeaf = self;
-    this->nextLeaf = newBlock;
-    for (int i = leftKeyNum; i < keyNum; i++) newNode.insertData(parentNode, key[i], data[i]);
-    newNode.writeBackToBuffer();
+    newNode.setNextLeaf(getNextLeaf());
+    newNode.setPrevLeaf(self);
+    setNextLeaf(newBlock);
+    for (int i = leftKeyNum; i < keyNum; i++) newNode.insertData(parentNode, getKey(i), getData(i));
 
-    this->keyNum = leftKeyNum;
+    setKeyNum(leftKeyNum);
+    markDirty();
     if (!parentNode) {
-        int parentBlock = buffer->allocNewBlock(filename);
-        NodeType parentNode(buffer, filename, parentBlock, rank, false);
-        parentNode.child[0] = self;
-        parentNode.addKey(key[leftKeyNum], newBlock);
-        parentNode.writeBackToBuffer();
+        int parentBlock = buffer->allocNewBlock(file);
+        NodeType parentNode(buffer, file, parentBlock, rank, false);
+        parentNode.setChild(0, self);
+        parentNode.addKey(getKey(leftKeyNum), newBlock);
         retval = parentBlock;
     }
     else {
-        parentNode->addKey(key[leftKeyNum], newBlock);
+        parentNode->addKey(getKey(leftKeyNum), newBlock);
     }
 
     return retval;
@@ -290,25 +322,25 @@ int BPlusNode<KeyType, DataType>::splitNode_leaf(NodeType *parentNode) {
 template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::splitNode_intern(NodeType *parentNode) {
     int retval = 0;
+    int keyNum = getKeyNum();
     int leftKeyNum = keyNum / 2;
 
-    int newBlock = buffer->allocNewBlock(filename);
-    NodeType newNode(buffer, filename, newBlock, rank, false);
-    newNode.child[0] = child[leftKeyNum + 1];
-    for (int i = leftKeyNum + 1; i < keyNum; i++) newNode.addKey(key[i], child[i + 1]);
-    newNode.writeBackToBuffer();
+    int newBlock = buffer->allocNewBlock(file);
+    NodeType newNode(buffer, file, newBlock, rank, false);
+    newNode.setChild(0, getChild(leftKeyNum + 1));
+    for (int i = leftKeyNum + 1; i < keyNum; i++) newNode.addKey(getKey(i), getChild(i + 1));
 
-    keyNum = leftKeyNum;
+    setKeyNum(leftKeyNum);
+    markDirty();
     if (!parentNode) {
-        int parentBlock = buffer->allocNewBlock(filename);
-        NodeType parentNode(buffer, filename, parentBlock, rank, false);
-        parentNode.child[0] = self;
-        parentNode.addKey(key[leftKeyNum], newBlock);
-        parentNode.writeBackToBuffer();
+        int parentBlock = buffer->allocNewBlock(file);
+        NodeType parentNode(buffer, file, parentBlock, rank, false);
+        parentNode.setChild(0, self);
+        parentNode.addKey(getKey(leftKeyNum), newBlock);
         retval = parentBlock;
     }
     else {
-        parentNode->addKey(key[leftKeyNum], newBlock);
+        parentNode->addKey(getKey(leftKeyNum), newBlock);
     }
 
     return retval;
@@ -316,29 +348,30 @@ int BPlusNode<KeyType, DataType>::splitNode_intern(NodeType *parentNode) {
 
 template<typename KeyType, typename DataType>
 bool BPlusNode<KeyType, DataType>::checkData(const KeyType &guideKey) const {
-    if (isLeaf) return checkData_leaf(guideKey);
+    if (isLeaf()) return checkData_leaf(guideKey);
     else return checkData_intern(guideKey);
 }
 
 template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::insertData(NodeType *parentNode, const KeyType &newKey, const DataType &newData) {
-    if (isLeaf) return insertData_leaf(parentNode, newKey, newData);
+    if (isLeaf()) return insertData_leaf(parentNode, newKey, newData);
     else return insertData_intern(parentNode, newKey, newData);
 }
 
 template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::removeData(NodeType *parentNode, const KeyType &guideKey) {
-    if (isLeaf) removeData_leaf(parentNode, guideKey);
+    if (isLeaf()) removeData_leaf(parentNode, guideKey);
     else removeData_intern(parentNode, guideKey);
 }
 
 template<typename KeyType, typename DataType>
 bool BPlusNode<KeyType, DataType>::checkData_leaf(const KeyType &guideKey) const {
-    int left = 0, right = keyNum - 1;
+    int left = 0, right = getKeyNum() - 1;
     while (left <= right) {
         int mid = (left + right) / 2;
-        if (guideKey == key[mid]) return true;
-        else if (guideKey < key[mid]) right = mid - 1;
+        KeyType midKey = getKey(mid);
+        if (guideKey == midKey) return true;
+        else if (guideKey < midKey) right = mid - 1;
         else left = mid + 1;
     }
     return false;
@@ -348,7 +381,7 @@ template<typename KeyType, typename DataType>
 bool BPlusNode<KeyType, DataType>::checkData_intern(const KeyType &guideKey) const {
     int next = findNextPath(guideKey);
 
-    const NodeType childNode(buffer, filename, child[next], rank);
+    const NodeType childNode(buffer, file, getChild(next), rank, PageIntent::READ_ONLY);
     return childNode.checkData(guideKey);
 }
 
@@ -356,15 +389,17 @@ template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::insertData_leaf(NodeType *parentNode, const KeyType &newKey, const DataType &newData) {
     if (checkData(newKey)) throw BPlusTreeException::DuplicateKey;
 
-    int i;
-    for (i = keyNum; i > 0 && key[i - 1] > newKey; i--) {
-        key[i] = key[i - 1];
-        data[i] = data[i - 1];
+    int i, keyNum = getKeyNum();
+    for (i = keyNum; i > 0 && getKey(i - 1) > newKey; i--) {
+        setKey(i, getKey(i - 1));
+        setData(i, getData(i - 1));
     }
-    key[i] = newKey;
-    data[i] = newData;
+    setKey(i, newKey);
+    setData(i, newData);
+    setKeyNum(++keyNum);
+    markDirty();
 
-    if (++keyNum > rank) return splitNode(parentNode);
+    if (keyNum > rank) return splitNode(parentNode);
     else return 0;
 }
 
@@ -372,11 +407,10 @@ template<typename KeyType, typename DataType>
 int BPlusNode<KeyType, DataType>::insertData_intern(NodeType *parentNode, const KeyType &newKey, const DataType &newData) {
     int next = findNextPath(newKey);
 
-    NodeType childNode(buffer, filename, child[next], rank);
+    NodeType childNode(buffer, file, getChild(next), rank);
     childNode.insertData(this, newKey, newData);
-    childNode.writeBackToBuffer();
 
-    if (keyNum >= rank) return splitNode(parentNode);
+    if (getKeyNum() >= rank) return splitNode(parentNode);
     else return 0;
 }
 
@@ -384,56 +418,58 @@ template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::removeData_leaf(NodeType *parentNode, const KeyType &guideKey) {
     if (!checkData(guideKey)) throw BPlusTreeException::KeyNotExist;
 
-    int i = 0;
-    while (key[i] != guideKey) i++;
+    int i = 0, keyNum = getKeyNum();
+    while (getKey(i) != guideKey) i++;
     for (; i < keyNum - 1; i++) {
-        key[i] = key[i + 1];
-        data[i] = data[i + 1];
+        setKey(i, getKey(i + 1));
+        setData(i, getData(i + 1));
     }
-
-    if (--keyNum < (rank + 1) / 2 && parentNode) {
-        int ind = parentNode->findNextPath(key[0]);
-        int prev = (ind > 0) ? (parentNode->child[ind - 1]) : 0;
-        int next = (ind < parentNode->keyNum) ? (parentNode->child[ind + 1]) : 0;
-
-        NodeType prevNode(buffer, filename, prev, rank);
-        NodeType nextNode(buffer, filename, next, rank);
-
-        if (prev && prevNode.keyNum > (rank + 1) / 2) {
-            KeyType xKey = prevNode.key[prevNode.keyNum - 1];
-            DataType xData = prevNode.data[prevNode.keyNum - 1];
-            prevNode.removeData(parentNode, xKey);
+    setKeyNum(--keyNum);
+    markDirty();
+
+    if (keyNum < (rank + 1) / 2 && parentNode) {
+        int ind = parentNode->findNextPath(getKey(0));
+        int prev = (ind > 0) ? (parentNode->getChild(ind - 1)) : 0;
+        int next = (ind < parentNode->getKeyNum()) ? (parentNode->getChild(ind + 1)) : 0;
+
+        //ֵܲʱ飨0ſԪҳ
+        std::unique_ptr<NodeType> prevNode(prev ? new NodeType(buffer, file, prev, rank) : nullptr);
+        std::unique_ptr<NodeType> nextNode(next ? new NodeType(buffer, file, next, rank) : nullptr);
+
+        if (prev && prevNode->getKeyNum() > (rank + 1) / 2) {
+            KeyType xKey = prevNode->getKey(prevNode->getKeyNum() - 1);
+            DataType xData = prevNode->getData(prevNode->getKeyNum() - 1);
+            prevNode->removeData(parentNode, xKey);
             insertData(parentNode, xKey, xData);
             parentNode->changeKey(guideKey, xKey);
-
-            prevNode.writeBackToBuffer();
         }
-        else if (next && nextNode.keyNum > (rank + 1) / 2) {
-            KeyType xKey = nextNode.key[0];
-            KeyType parentNewKey = nextNode.key[1];
-            DataType xData = nextNode.data[0];
-            nextNode.removeData(parentNode, xKey);
+        else if (next && nextNode->getKeyNum() > (rank + 1) / 2) {
+            KeyType xKey = nextNode->getKey(0);
+            KeyType parentNewKey = nextNode->getKey(1);
+            DataType xData = nextNode->getData(0);
+            nextNode->removeData(parentNode, xKey);
             insertData(parentNode, xKey, xData);
             parentNode->changeKey(xKey, parentNewKey);
-
-            nextNode.writeBackToBuffer();
         }
         else if (prev) {
-            for (int i = 0; i < keyNum; i++) prevNode.insertData(nullptr, key[i], data[i]);
-            parentNode->deleteKey(key[0]);
-            prevNode.nextLeaf = nextLeaf;
-            if (nextLeaf) nextNode.prevLeaf = prevLeaf;
-
-            prevNode.writeBackToBuffer();
+            for (int i = 0; i < keyNum; i++) prevNode->insertData(nullptr, getKey(i), getData(i));
+            parentNode->deleteKey(getKey(0));
+            prevNode->setNextLeaf(getNextLeaf());
+            prevNode->markDirty();
+            if (getNextLeaf()) {
+                NodeType newNextNode(buffer, file, getNextLeaf(), rank);
+                newNextNode.setPrevLeaf(getPrevLeaf());
+                newNextNode.markDirty();
+            }
         }
         else if (next) {
-            for (int i = 0; i < nextNode.keyNum; i++) insertData(nullptr, nextNode.key[i], nextNode.data[i]);
-            parentNode->deleteKey(nextNode.key[0]);
-            nextLeaf = nextNode.nextLeaf;
-            if (nextLeaf) {
-                NodeType newNextNode(buffer, filename, nextLeaf, rank);
-                newNextNode.prevLeaf = self;
-                newNextNode.writeBackToBuffer();
+            for (int i = 0; i < nextNode->getKeyNum(); i++) insertData(nullptr, nextNode->getKey(i), nextNode->getData(i));
+            parentNode->deleteKey(nextNode->getKey(0));
+            setNextLeaf(nextNode->getNextLeaf());
+            if (getNextLeaf()) {
+                NodeType newNextNode(buffer, file, getNextLeaf(), rank);
+                newNextNode.setPrevLeaf(self);
+                newNextNode.markDirty();
             }
         }
     }
@@ -442,50 +478,46 @@ void BPlusNode<KeyType, DataType>::removeData_leaf(NodeType *parentNode, const K
 template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::removeData_intern(NodeType *parentNode, const KeyType &guideKey) {
     int next = findNextPath(guideKey);
-    NodeType childNode(buffer, filename, child[next], rank);
-    childNode.removeData(this, guideKey);
-    childNode.writeBackToBuffer();
+    {
+        NodeType childNode(buffer, file, getChild(next), rank);
+        childNode.removeData(this, guideKey);
+    }
 
+    int keyNum = getKeyNum();
     if (keyNum < (rank - 1) / 2 && parentNode) {
-        int ind = parentNode->findNextPath(key[0]);
-        int prev = (ind > 0) ? (parentNode->child[ind - 1]) : 0;
-        int next = (ind < parentNode->keyNum) ? (parentNode->child[ind + 1]) : 0;
+        int ind = parentNode->findNextPath(getKey(0));
+        int prev = (ind > 0) ? (parentNode->getChild(ind - 1)) : 0;
+        int next = (ind < parentNode->getKeyNum()) ? (parentNode->getChild(ind + 1)) : 0;
 
-        NodeType prevNode(buffer, filename, prev, rank);
-        NodeType nextNode(buffer, filename, next, rank);
+        std::unique_ptr<NodeType> prevNode(prev ? new NodeType(buffer, file, prev, rank) : nullptr);
+        std::unique_ptr<NodeType> nextNode(next ? new NodeType(buffer, file, next, rank) : nullptr);
 
-        if (prev && prevNode.keyNum > (rank - 1) / 2) {
-            KeyType pKey = parentNode->key[ind - 1];
-            KeyType sKey = prevNode.key[prevNode.keyNum - 1];
-            int sChild = prevNode.child[prevNode.keyNum];
+        if (prev && prevNode->getKeyNum() > (rank - 1) / 2) {
+            KeyType pKey = parentNode->getKey(ind - 1);
+            KeyType sKey = prevNode->getKey(prevNode->getKeyNum() - 1);
+            int sChild = prevNode->getChild(prevNode->getKeyNum());
             addKey(pKey, sChild, false);
             parentNode->changeKey(pKey, sKey);
-            prevNode.deleteKey(sKey);
-
-            prevNode.writeBackToBuffer();
+            prevNode->deleteKey(sKey);
         }
-        else if (next && nextNode.keyNum > (rank - 1) / 2) {
-            KeyType pKey = parentNode->key[ind];
-            KeyType sKey = nextNode.key[0];
-            int sChild = nextNode.child[0];
+        else if (next && nextNode->getKeyNum() > (rank - 1) / 2) {
+            KeyType pKey = parentNode->getKey(ind);
+            KeyType sKey = nextNode->getKey(0);
+            int sChild = nextNode->getChild(0);
             addKey(pKey, sChild);
             parentNode->changeKey(pKey, sKey);
-            nextNode.deleteKey(sKey, false);
-
-            nextNode.writeBackToBuffer();
+            nextNode->deleteKey(sKey, false);
         }
         else if (prev) {
-            KeyType pKey = parentNode->key[ind - 1];
-            prevNode.addKey(pKey, child[0]);
-            for (int i = 0; i < keyNum; i++) prevNode.addKey(key[i], child[i + 1]);
+            KeyType pKey = parentNode->getKey(ind - 1);
+            prevNode->addKey(pKey, getChild(0));
+            for (int i = 0; i < keyNum; i++) prevNode->addKey(getKey(i), getChild(i + 1));
             parentNode->deleteKey(pKey);
-
-            prevNode.writeBackToBuffer();
         }
         else if (next) {
-            KeyType pKey = parentNode->key[ind];
-            addKey(pKey, nextNode.child[0]);
-            for (int i = 0; i < nextNode.keyNum; i++) addKey(nextNode.key[i], nextNode.child[i + 1]);
+            KeyType pKey = parentNode->getKey(ind);
+            addKey(pKey, nextNode->getChild(0));
+            for (int i = 0; i < nextNode->getKeyNum(); i++) addKey(nextNode->getKey(i), nextNode->getChild(i + 1));
             parentNode->deleteKey(pKey);
         }
     }
@@ -493,64 +525,72 @@ void BPlusNode<KeyType, DataType>::removeData_intern(NodeType *parentNode, const
 
 template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::addKey(const KeyType &newKey, int newChild, bool childAtRight) {
-    int i;
-    if (!childAtRight) child[keyNum + 1] = child[keyNum];
-    for (i = keyNum; i > 0 && key[i - 1] > newKey; i--) {
-        key[i] = key[i - 1];
-        child[i + childAtRight] = child[i - 1 + childAtRight];
+    int i, keyNum = getKeyNum();
+    if (!childAtRight) setChild(keyNum + 1, getChild(keyNum));
+    for (i = keyNum; i > 0 && getKey(i - 1) > newKey; i--) {
+        setKey(i, getKey(i - 1));
+        setChild(i + childAtRight, getChild(i - 1 + childAtRight));
     }
-    key[i] = newKey;
-    child[i + childAtRight] = newChild;
+    setKey(i, newKey);
+    setChild(i + childAtRight, newChild);
 
-    keyNum++;
+    setKeyNum(keyNum + 1);
+    markDirty();
 }
 
 template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::changeKey(const KeyType &oldKey, const KeyType &newKey) {
     int i = findNextPath(oldKey) - 1;
     if (0 > i) throw BPlusTreeException::KeyNotExist;
-    key[i] = newKey;
+    setKey(i, newKey);
+    markDirty();
 }
 
 template<typename KeyType, typename DataType>
 void BPlusNode<KeyType, DataType>::deleteKey(const KeyType &guideKey, bool childAtRight) {
     int i = findNextPath(guideKey) - 1;
     if (0 > i) throw BPlusTreeException::KeyNotExist;
-    for (; i < this->keyNum - 1; i++) {
-        key[i] = key[i + 1];
-        child[i + childAtRight] = child[i + 1 + childAtRight];
+    int keyNum = getKeyNum();
+    for (; i < keyNum - 1; i++) {
+        setKey(i, getKey(i + 1));
+        setChild(i + childAtRight, getChild(i + 1 + childAtRight));
     }
-    if (!childAtRight) child[i] = child[i + 1];
-    keyNum--;
+    if (!childAtRight) setChild(i, getChild(i + 1));
+    setKeyNum(keyNum - 1);
+    markDirty();
 }
 
 template<typename KeyType, typename DataType>
 typename BPlusNode<KeyType, DataType>::iter BPlusNode<KeyType, DataType>::getFirst() const {
-    if (isLeaf) {
-        if (keyNum > 0) return iter(this, 0);
+    if (isLeaf()) {
+        if (getKeyNum() > 0) return iter(this, 0);
         else return iter(nullptr, 0);
     }
     else {
-        const NodeType childNode(buffer, filename, child[0], rank);
+        const NodeType childNode(buffer, file, getChild(0), rank, PageIntent::READ_ONLY);
         return childNode.getFirst();
     }
 }
 
 template<typename KeyType, typename DataType>
 typename BPlusNode<KeyType, DataType>::iter BPlusNode<KeyType, DataType>::getStart(const KeyType &guideKey, bool canEqual) const {
-    if (isLeaf) return getStart_leaf(guideKey, canEqual);
+    if (isLeaf()) return getStart_leaf(guideKey, canEqual);
     else return getStart_intern(guideKey, canEqual);
 }
 
 template<typename KeyType, typename DataType>
 typename BPlusNode<KeyType, DataType>::iter BPlusNode<KeyType, DataType>::getStart_leaf(const KeyType &guideKey, bool canEqual) const {
-    if (key[keyNum - 1] < guideKey || (key[keyNum - 1] == guideKey && !canEqual)) {
+    int keyNum = getKeyNum();
+    if (0 == keyNum) return iter(nullptr, 0);
+    KeyType lastKey = getKey(keyNum - 1);
+    if (lastKey < guideKey || (lastKey == guideKey && !canEqual)) {
         iter it(this, keyNum - 1);
         it.next();
         return it;
     }
     for (int i = 0; i < keyNum; i++) {
-        if (key[i] > guideKey || (key[i] == guideKey && canEqual)) return iter(this, i);
+        KeyType k = getKey(i);
+        if (k > guideKey || (k == guideKey && canEqual)) return iter(this, i);
     }
     return iter(nullptr, 0);
 }
@@ -559,7 +599,7 @@ template<typename KeyType, typename DataType>
 typename BPlusNode<KeyType, DataType>::iter BPlusNode<KeyType, DataType>::getStart_intern(const KeyType &guideKey, bool canEqual) const {
     int next = findNextPath(guideKey);
 
-    const NodeType childNode(buffer, filename, child[next], rank);
+    const NodeType childNode(buffer, file, getChild(next), rank, PageIntent::READ_ONLY);
     return childNode.getStart(guideKey, canEqual);
 }
 
@@ -574,6 +614,8 @@ typename BPlusNode<KeyType, DataType>::iter BPlusNode<KeyType, DataType>::getSta
 /*                                          */
 
 class BPlusTreeInterface {
+public:
+    virtual ~BPlusTreeInterface() = default;
     virtual void print() const {};
 }; //IndexManager
 
@@ -588,18 +630,30 @@ public:
     void insertData(const KeyType &key, const DataType &data);
     void removeData(const KeyType &key);
 
+    //ԵΪգsource.next(key, data)θcountֵ
+    //ҶӺڲ㰴fill(0.5~1)װƽ
+    template<typename Source>
+    void bulkLoad(Source &source, size_t count, double fill);
+
     const typename NodeType::iter begin();
     const typename NodeType::iter end() { return NodeType::iter::iter(nullptr, 0); }
     typename NodeType::iter getStart(const KeyType &key, bool canEqual) const;
 
     /*void print() const {
-        const NodeType rootNode(buffer, filename, root, rank);
+        const NodeType rootNode(buffer, file, root, rank, PageIntent::READ_ONLY);
         rootNode.print();
     }*/
 
 private:
+    //ѸдԪҳ
+    void setRoot(int newRoot) {
+        root = newRoot;
+        PageGuard meta = buffer->fetchPage(file, META_PAGE_ID, PageIntent::WRITE);
+        reinterpret_cast<int*>(meta.data())[0] = root;
+    }
+
     BufferManager *buffer;
-    const string filename;
+    const int file;
     int root;
     const int rank;
 };
@@ -609,60 +663,137 @@ private:
 /*                                          */
 
 template<typename KeyType, typename DataType>
-BPlusTree<KeyType, DataType>::BPlusTree(BufferManager *buffer, const string &filename, int rank) : buffer(buffer), filename(filename), rank(rank) {
+BPlusTree<KeyType, DataType>::BPlusTree(BufferManager *buffer, const string &filename, int rank) : buffer(buffer), file(buffer->registerFile(filename, AccessPattern::RANDOM)), rank(rank) {
     try {
-        char *meta = buffer->getBlockContent(filename, META_PAGE_ID);
-        root = reinterpret_cast<int*>(meta)[0];
+        PageGuard meta = buffer->fetchPage(file, META_PAGE_ID);
+        root = reinterpret_cast<int*>(meta.data())[0];
     }
     catch (MiniSQLException) {
-        FILE *fp;
-        fopen_s(&fp, filename.data(), "w");
-        fclose(fp);
-        buffer->allocNewBlock(filename);
-        root = buffer->allocNewBlock(filename);
-        buffer->setBlockContent(filename, META_PAGE_ID, 0, reinterpret_cast<char*>(&root), sizeof(root));
-        NodeType rootNode(buffer, filename, root, rank, true);
-        rootNode.writeBackToBuffer();
+        buffer->createFile(filename);
+        buffer->allocNewBlock(file);
+        setRoot(buffer->allocNewBlock(file));
+        NodeType rootNode(buffer, file, root, rank, true);
     }
 }
 
 template<typename KeyType, typename DataType>
 bool BPlusTree<KeyType, DataType>::checkData(const KeyType &key) const {
-    const NodeType rootNode(buffer, filename, root, rank);
+    const NodeType rootNode(buffer, file, root, rank, PageIntent::READ_ONLY);
     return rootNode.checkData(key);
 }
 
 template<typename KeyType, typename DataType>
 void BPlusTree<KeyType, DataType>::insertData(const KeyType &key, const DataType &data){
-    NodeType rootNode(buffer, filename, root, rank);
+    NodeType rootNode(buffer, file, root, rank);
     int newRoot = rootNode.insertData(nullptr, key, data);
-    rootNode.writeBackToBuffer();
     if (newRoot) {
-        root = newRoot;
-        buffer->setBlockContent(filename, META_PAGE_ID, 0, reinterpret_cast<char*>(&root), sizeof(root));
+        setRoot(newRoot);
     }
 }
 
 template<typename KeyType, typename DataType>
 void BPlusTree<KeyType, DataType>::removeData(const KeyType &key) {
-    NodeType rootNode(buffer, filename, root, rank);
+    NodeType rootNode(buffer, file, root, rank);
     rootNode.removeData(nullptr, key);
-    rootNode.writeBackToBuffer();
-    if (0 == rootNode.keyNum && false == rootNode.isLeaf) {
-        root = rootNode.child[0];
-        NodeType newRootNode(buffer, filename, root, rank);
-        buffer->setBlockContent(filename, META_PAGE_ID, 0, reinterpret_cast<char*>(&root), sizeof(root));
+    if (0 == rootNode.getKeyNum() && false == rootNode.isLeaf()) {
+        setRoot(rootNode.getChild(0));
+    }
+}
+
+template<typename KeyType, typename DataType>
+template<typename Source>
+void BPlusTree<KeyType, DataType>::bulkLoad(Source &source, size_t count, double fill) {
+    {
+        const NodeType rootNode(buffer, file, root, rank, PageIntent::READ_ONLY);
+        if (!rootNode.isLeaf() || rootNode.getKeyNum() > 0) throw MiniSQLException("Bulk Load Needs an Empty Index!");
+    }
+    if (0 == count) return;
+    if (fill < 0.5) fill = 0.5;
+    if (fill > 1) fill = 1;
+
+    //ÿͽҶӴrank*fillڲrank*fillӣ
+    //ܶൽƽĽɾʱҪޣҶ(rank+1)/2ڲ(rank-1)/2
+    auto nodeCount = [](size_t n, int cap, int minSize, int maxSize) {
+        size_t m = (n + cap - 1) / cap;
+        m = std::min(m, std::max<size_t>(1, n / minSize));
+        return std::max(m, (n + maxSize - 1) / maxSize);
+    };
+    int leafCap = std::max(1, (int)(rank * fill));
+    int internCap = std::max(2, (int)(rank * fill));
+    std::vector<size_t> items(1, count), nodes(1, nodeCount(count, leafCap, (rank + 1) / 2, rank));
+    while (nodes.back() > 1) {
+        items.push_back(nodes.back());
+        nodes.push_back(nodeCount(items.back(), internCap, (rank - 1) / 2 + 1, rank));
+    }
+    int height = (int)nodes.size();
+    auto nodeSize = [&](int level, size_t j) { return (int)(items[level] / nodes[level] + ((j < items[level] % nodes[level]) ? 1 : 0)); };
+
+    //ÿĽ㣨ұߵһǼǵһ
+    std::vector<std::unique_ptr<NodeType>> open(height);
+    std::vector<size_t> done(height, 0);
+    std::vector<int> filled(height, 0);
+    std::vector<KeyType> minKey(height);
+    std::function<void(int, const KeyType&, int)> addToParent = [&](int level, const KeyType &key, int block) {
+        if (level == height) {//ֻһ㣬Ϊ
+            setRoot(block);
+            return;
+        }
+        if (!open[level]) {
+            open[level].reset(new NodeType(buffer, file, buffer->allocNewBlock(file), rank, false));
+            open[level]->setChild(0, block);
+            minKey[level] = key;
+        }
+        else {
+            NodeType &node = *open[level];
+            int keyNum = node.getKeyNum();
+            node.setKey(keyNum, key);
+            node.setChild(keyNum + 1, block);
+            node.setKeyNum(keyNum + 1);
+        }
+        if (++filled[level] == nodeSize(level, done[level])) {
+            int self = open[level]->self;
+            open[level].reset();
+            filled[level] = 0;
+            done[level]++;
+            addToParent(level + 1, minKey[level], self);
+        }
+    };
+
+    //ĸҶӣΪһҶ
+    int leafBlock = root;
+    int prevBlock = 0;
+    KeyType key, lastKey = KeyType();
+    DataType data;
+    for (size_t j = 0; j < nodes[0]; j++) {
+        NodeType leaf(buffer, file, leafBlock, rank, true);
+        int size = nodeSize(0, j);
+        for (int i = 0; i < size; i++) {
+            if (!source.next(key, data)) throw MiniSQLException("Bulk Load Input Too Short!");
+            if (i > 0 || j > 0) {
+                if (key == lastKey) throw BPlusTreeException::DuplicateKey;
+                if (key < lastKey) throw MiniSQLException("Bulk Load Input Not Sorted!");
+            }
+            leaf.setKey(i, key);
+            leaf.setData(i, data);
+            lastKey = key;
+        }
+        leaf.setKeyNum(size);
+        leaf.setPrevLeaf(prevBlock);
+        leaf.setNextLeaf((j + 1 < nodes[0]) ? buffer->allocNewBlock(file) : 0);
+        prevBlock = leafBlock;
+        leafBlock = leaf.getNextLeaf();
+        addToParent(1, leaf.getKey(0), prevBlock);
     }
 }
 
 template<typename KeyType, typename DataType>
 const typename BPlusNode<KeyType, DataType>::iter BPlusTree<KeyType, DataType>::begin() {
-    const NodeType rootNode(buffer, filename, root, rank);
+    const NodeType rootNode(buffer, file, root, rank, PageIntent::READ_ONLY);
     return rootNode.getFirst();
 }
 
 template<typename KeyType, typename DataType>
 typename BPlusNode<KeyType, DataType>::iter BPlusTree<KeyType, DataType>::getStart(const KeyType &key, bool canEqual) const {
-    const NodeType rootNode(buffer, filename, root, rank);
+    const NodeType rootNode(buffer, file, root, rank, PageIntent::READ_ONLY);
     return rootNode.getStart(key, canEqual);
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "MiniSQLAPI.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+
+#define UNIQUE_INDEX_NAME(attrname) ("$UNIQUE_" + (attrname))   //uniqueԵûֲ'$'
 
 void API::checkPredicate(const string &tablename, const Predicate &pred) const {
     const Table &table = CM->getTableInfo(tablename);
@@ -110,99 +114,449 @@ std::map<Compare, std::set<Value>> API::filterCondition(const std::vector<Condit
     return newCond;
 }
 
-void API::createTable(const string &tablename, const std::vector<Attr> &attrs, const set<string> &primary_key) {
+//˾Ͳɾɾؽͬʱ
+API::RWLock &API::tableLock(const string &tablename) {
+    std::lock_guard<std::mutex> guard(table_locks_lock);
+    auto &lock = table_locks[tablename];
+    if (!lock) lock.reset(new RWLock());
+    return *lock;
+}
+
+API::Statement::Statement(API *api, const string &tablename) : api(api), tablename(tablename), done(false) {
+    txn = api->BM->beginTransaction();
+}
+
+//ʱڴ޸ύ־ڴпɼ״̬һ£ֻύһ
+void API::Statement::commit() {
+    if (done) return;
+    done = true;
+    if (txn != 0) api->LM->logCatalog(txn, tablename, api->CM->dumpTable(tablename));
+    api->BM->commitTransaction();
+    api->CM->commitTable(tablename);
+    if (txn != 0) api->LM->end(txn);
+}
+
+API::~API() {
+    {
+        std::lock_guard<std::mutex> lock(checkpointer_lock);
+        stopping = true;
+    }
+    checkpointer_wake.notify_all();
+    if (checkpointer.joinable()) checkpointer.join();
+}
 
-    CM->addTableInfo(tablename, attrs);
-    RM->createTable(tablename);
-    if(primary_key.size() > 0) createIndex(tablename, "PRIMARY_KEY", primary_key);
+void API::checkpoint() {
+    WriteLock catalog(catalog_lock);
+    writeCheckpoint();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(checkpointer_lock);
+        std::swap(error, checkpoint_error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+//пдʱûне
+void API::writeCheckpoint() {
+    if (LM == nullptr) return;
+    std::lock_guard<std::mutex> guard(checkpoint_lock);
+    BM->flushAll();
+    CM->save();
+    LM->truncate(LM->getLSN());
+}
+
+/*
+̨㣺дύҳҳָʱҪļ¼
+еĵһ¼ύδдصҳ޸ģ
+дļˢ̡ύıϢ֮ǰ־
+*/
+void API::fuzzyCheckpoint(int pages_per_second) {
+    std::lock_guard<std::mutex> guard(checkpoint_lock);
+    BM->flushCommitted(pages_per_second);
+    long long lsn = std::min(LM->getActiveLSN(), BM->getRecoveryLSN());
+    BM->syncFiles();
+    CM->save();
+    LM->truncate(lsn);
+}
+
+void API::startCheckpointer(const FlushConfig &config) {
+    if (LM == nullptr || checkpointer.joinable()) return;
+    if (config.checkpoint_interval <= 0 && config.checkpoint_log_size <= 0) return;
+    checkpointer = std::thread(&API::checkpointLoop, this, config);
+}
+
+//ÿ뿴һΣϴμ־ϴμcheckpoint_log_size
+//ʧʱ쳣㣬һ
+void API::checkpointLoop(FlushConfig config) {
+    auto last = std::chrono::steady_clock::now();
+    long long retained = LM->getLogSize();
+    std::unique_lock<std::mutex> lock(checkpointer_lock);
+    while (!stopping) {
+        checkpointer_wake.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; });
+        if (stopping) break;
+        bool due = config.checkpoint_interval > 0 && std::chrono::steady_clock::now() - last >= std::chrono::seconds(config.checkpoint_interval);
+        due = due || (config.checkpoint_log_size > 0 && LM->getLogSize() - retained >= config.checkpoint_log_size);
+        if (!due) continue;
+        lock.unlock();
+        std::exception_ptr error;
+        try { fuzzyCheckpoint(config.checkpoint_rate); }
+        catch (MiniSQLException &e) {
+            error = std::make_exception_ptr(MiniSQLException("Background Checkpoint Failed: " + e.getMessage()));
+        }
+        lock.lock();
+        if (error) {
+            checkpoint_error = error;
+            continue;
+        }
+        last = std::chrono::steady_clock::now();
+        retained = LM->getLogSize();
+    }
+}
+
+void API::createTable(const string &tablename, const std::vector<Attr> &attrs, const set<string> &primary_key) {
+    WriteLock catalog(catalog_lock);
+    Statement statement(this, tablename);
+    try {
+        CM->addTableInfo(tablename, attrs);
+        RM->createTable(tablename);
+        if(primary_key.size() > 0) addIndex(tablename, "PRIMARY_KEY", primary_key);
+    }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
 }
 
 void API::dropTable(const string &tablename) {
-    const auto &indexes = CM->getIndexInfo(tablename);
-    for (const auto &index : indexes) IM->dropIndex(tablename, index.name);
+    WriteLock catalog(catalog_lock);
+    Statement statement(this, tablename);
+    try {
+        const auto &indexes = CM->getIndexInfo(tablename);
+        for (const auto &index : indexes) IM->dropIndex(tablename, index.name);
 
-    CM->deleteTableInfo(tablename);
-    CM->deleteIndexInfo(tablename);
-    RM->dropTable(tablename);
+        CM->deleteTableInfo(tablename);
+        CM->deleteIndexInfo(tablename);
+        RM->dropTable(tablename);
+    }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
 }
 
-void API::createIndex(const string &tablename, const string &indexname, const set<string> &keys) {
-    const Table &table = CM->getTableInfo(tablename);
-    Type primary_key_type;
-    int attr_pos = 0;
-    size_t basic_length = sizeof(bool) + sizeof(int) * 3;
+//ڵУһΪΪuniqueԣ
+size_t API::indexKeyColumn(const Table &table, const set<string> &keys) const {
+    size_t key_column = 0;
     for (const auto &key : keys) {
         bool key_exists = false;
-        for (const auto &attr : table.attrs) {
-            if (key == attr.name) {
-                if (false == attr.unique) throw MiniSQLException("Index Key Is Not Unique!");
-                primary_key_type = attr.type;
+        for (size_t column = 0; column < table.attrs.size(); column++) {
+            if (key == table.attrs[column].name) {
+                if (false == table.attrs[column].unique) throw MiniSQLException("Index Key Is Not Unique!");
+                key_column = column;
                 key_exists = true;
                 break;
             }
-            attr_pos++;
         }
         if(!key_exists) throw MiniSQLException("Invalid Index Key Identifier!");
     }
+    return key_column;
+}
+
+//ҳͺڼ¼еƫ
+void API::locateIndexKey(const Table &table, const set<string> &keys, Type &key_type, size_t &key_offset) const {
+    size_t key_column = indexKeyColumn(table, keys);
+    key_type = table.attrs[key_column].type;
+    key_offset = 0;
+    for (size_t column = 0; column < key_column; column++) key_offset += table.attrs[column].type.size;
+}
+
+void API::createIndex(const string &tablename, const string &indexname, const set<string> &keys) {
+    ReadLock catalog(catalog_lock);
+    WriteLock table(tableLock(tablename));
+    Statement statement(this, tablename);
+    try { addIndex(tablename, indexname, keys); }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
+}
 
-    if (primary_key_type.btype == BaseType::CHAR) primary_key_type.size = MAXCHARSIZE;
-    size_t rank = (PAGESIZE - basic_length) / (sizeof(int) + sizeof(Position) + primary_key_type.size) - 1;
+void API::addIndex(const string &tablename, const string &indexname, const set<string> &keys) {
+    const Table &table = CM->getTableInfo(tablename);
+    Type primary_key_type;
+    size_t key_offset;//ڼ¼еƫ
+    locateIndexKey(table, keys, primary_key_type, key_offset);
+
+    //ַгֵһȡMAXCHARSIZE
+    if (primary_key_type.btype == BaseType::CHAR) primary_key_type.size = IndexManager::getCharKeySize(primary_key_type.size);
+    int rank = IndexManager::getRank(primary_key_type.size);
 
     CM->addIndexInfo(tablename, indexname, rank, keys);
-    switch (primary_key_type.btype) {
-    case BaseType::CHAR:    IM->createIndex<FLString>(tablename, indexname, rank); break;
-    case BaseType::INT:    IM->createIndex<int>(tablename, indexname, rank); break;
-    case BaseType::FLOAT:    IM->createIndex<float>(tablename, indexname, rank); break;
-    }
-
-    ReturnTable T = selectFromTable(tablename, Predicate()).ret;
-    for (const auto &record : T) {
-        switch (primary_key_type.btype) {
-        case BaseType::CHAR:    IM->insertIntoIndex<FLString>(tablename, indexname, rank, FLString((record.content)[attr_pos].translate<char*>()), record.pos); break;
-        case BaseType::INT:    IM->insertIntoIndex<int>(tablename, indexname, rank, (record.content)[attr_pos].translate<int>(), record.pos); break;
-        case BaseType::FLOAT:    IM->insertIntoIndex<float>(tablename, indexname, rank, (record.content)[attr_pos].translate<float>(), record.pos); break;
+    try {
+        buildIndex(tablename, indexname, rank, primary_key_type, key_offset);
+    }
+    catch (...) {//ʧܣظ
+        CM->deleteIndexInfo(tablename, indexname);
+        IM->dropIndex(tablename, indexname);
+        throw;
+    }
+}
+
+//ɨȫȡ(,λ)ⲿԵ
+void API::buildIndex(const string &tablename, const string &indexname, int rank, const Type &key_type, size_t key_offset) {
+    const Table &table = CM->getTableInfo(tablename);
+    auto build = [&](auto key) {
+        using KeyType = decltype(key);
+        IM->createIndex<KeyType>(tablename, indexname, rank);
+        ExternalSorter<KeyType, Position> sorter(INDEX_FILE_PATH(tablename, indexname));
+        RM->forEachRecord(tablename, table, [&](const Position &pos, const char *content) {
+            readKey(key, content + key_offset);
+            sorter.add(key, pos);
+        });
+        IM->bulkLoadIndex<KeyType>(tablename, indexname, rank, sorter);
+    };
+    switch (key_type.btype) {
+    case BaseType::CHAR:    IndexManager::dispatchCharKey(rank, build); break;
+    case BaseType::INT:    build(int()); break;
+    case BaseType::FLOAT:    build(float()); break;
+    }
+}
+
+/*
+vacuum
+Ч¼յдļԭ滻ԭļ¼λ֮ı䣬
+ٰλؽñرļСֽ
+滻ǰ㣬־ﲻԭļ޸ģָʱļ
+*/
+long long API::vacuumTable(const string &tablename) {
+    WriteLock catalog(catalog_lock);
+    writeCheckpoint();
+    Statement statement(this, tablename);
+    long long reclaimed;
+    try {
+        const Table &table = CM->getTableInfo(tablename);
+        reclaimed = RM->compactTable(tablename, table);
+        CM->compactTableInfo(tablename);
+        rebuildIndexes(tablename);
+    }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
+    return reclaimed;
+}
+
+//еļ¼ؽñ
+void API::rebuildIndexes(const string &tablename) {
+    const Table &table = CM->getTableInfo(tablename);
+    const auto &indexes = CM->getIndexInfo(tablename);
+    for (const auto &index : indexes) {
+        Type key_type;
+        size_t key_offset;
+        locateIndexKey(table, index.keys, key_type, key_offset);
+        IM->dropIndex(tablename, index.name);
+        buildIndex(tablename, index.name, index.rank, key_type, key_offset);
+    }
+}
+
+//ؽڸϵĵûоͽһɱûɾԭеʱ
+const Index &API::getUniqueIndex(const string &tablename, const string &attrname) {
+    for (const auto &index : CM->getIndexInfo(tablename)) {
+        if (index.keys.size() == 1 && *index.keys.begin() == attrname) return index;
+    }
+    addIndex(tablename, UNIQUE_INDEX_NAME(attrname), { attrname });
+    return CM->getIndexInfo(tablename).back();
+}
+
+//ĳֵǷ
+bool API::findInIndex(const string &tablename, const Index &index, const Type &type, const Value &value) {
+    Position pos;
+    switch (type.btype) {
+    case BaseType::CHAR:
+        IndexManager::dispatchCharKey(index.rank, [&](auto key) {
+            using KeyType = decltype(key);
+            pos = IM->findOneFromIndex<KeyType>(tablename, index.name, index.rank, KeyType(value.translate<char*>()));
+        });
+        break;
+    case BaseType::INT:    pos = IM->findOneFromIndex<int>(tablename, index.name, index.rank, value.translate<int>()); break;
+    case BaseType::FLOAT:    pos = IM->findOneFromIndex<float>(tablename, index.name, index.rank, value.translate<float>()); break;
+    }
+    return pos.block_id != -1;
+}
+
+/*
+load data
+ļʽ¼ÿLOAD_BATCH_SIZEдһڴռޡ
+ĬÿinsertBatchءάʱǰѾ롣
+defer_indexʱֻļĩβ׷ӡȫؽ
+ظֵؽʱŲѼ¼˻صǰ׷ӵļ¼ٿɼؽ볷
+*/
+int API::loadData(const string &tablename, const string &filename, bool binary, bool defer_index) {
+    ReadLock catalog(catalog_lock);
+    WriteLock lock(tableLock(tablename));
+    Statement statement(this, tablename);
+    int count = 0;
+    try {
+        const Table &table = CM->getTableInfo(tablename);
+        std::unique_ptr<RowReader> reader(RowReader::create(filename, table, binary));
+        std::vector<Record> records;
+        //һ귵false
+        auto readBatch = [&]() {
+            records.clear();
+            while (records.size() < LOAD_BATCH_SIZE) {
+                records.emplace_back();
+                if (!reader->next(records.back())) {
+                    records.pop_back();
+                    break;
+                }
+            }
+            return !records.empty();
+        };
+
+        if (!defer_index) {
+            while (readBatch()) count += appendBatch(tablename, records);
+            statement.commit();
+            return count;
+        }
+
+        //ؽʱҪuniqueϵظֵ
+        for (const auto &attr : table.attrs) {
+            if (attr.unique) getUniqueIndex(tablename, attr.name);
+        }
+        int occupied_record_count = table.occupied_record_count;
+        int live_record_count = table.live_record_count;
+        try {
+            std::vector<Position> poses;
+            int free_slot;
+            while (readBatch()) {
+                convertRecords(table, records);
+                Table append_only = table;//ÿвۣʱֻ˻ؼ¼
+                append_only.free_slot = -1;
+                RM->insertRecords(tablename, append_only, records, poses, free_slot);
+                CM->increaseRecordCount(tablename, (int)records.size());
+                count += (int)records.size();
+            }
+            rebuildIndexes(tablename);
         }
+        catch (...) {
+            CM->setRecordCount(tablename, occupied_record_count, live_record_count);
+            rebuildIndexes(tablename);
+            throw;
+        }
+    }
+    catch (...) {
+        statement.commit();
+        throw;
     }
+    statement.commit();
+    return count;
+}
+
+void API::setFillFactor(double fill) {
+    WriteLock catalog(catalog_lock);
+    IM->setFillFactor(fill);
 }
 
 void API::dropIndex(const string &tablename, const string &indexname) {
-    CM->deleteIndexInfo(tablename, indexname);
-    IM->dropIndex(tablename, indexname);
+    ReadLock catalog(catalog_lock);
+    WriteLock table(tableLock(tablename));
+    Statement statement(this, tablename);
+    try {
+        CM->deleteIndexInfo(tablename, indexname);
+        IM->dropIndex(tablename, indexname);
+    }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
 }
 
 void API::insertIntoTable(const string &tablename, Record &record) {
-    const Table &table = CM->getTableInfo(tablename);
-    if (table.attrs.size() != record.size()) throw MiniSQLException("Wrong Number of Inserted Values!");
+    std::vector<Record> records(1, record);
+    insertBatch(tablename, records);
+}
 
-    //Valueת
-    auto value_ptr = record.begin();
-    for (const auto &attr : table.attrs) {
-        value_ptr->convertTo(attr.type);
-        value_ptr++;
+//ValueתΪе
+void API::convertRecords(const Table &table, std::vector<Record> &records) const {
+    for (auto &record : records) {
+        if (table.attrs.size() != record.size()) throw MiniSQLException("Wrong Number of Inserted Values!");
+        auto value_ptr = record.begin();
+        for (const auto &attr : table.attrs) {
+            value_ptr->convertTo(attr.type);
+            value_ptr++;
+        }
     }
+}
 
-    Position insertPos = RM->insertRecord(tablename, table, record);
-    CM->increaseRecordCount(tablename);
+/*
+insert
+תضͨд룬κһ룻
+¼ҳд룬ĸ°
+*/
+int API::insertBatch(const string &tablename, std::vector<Record> &records) {
+    ReadLock catalog(catalog_lock);
+    WriteLock lock(tableLock(tablename));
+    Statement statement(this, tablename);
+    int count;
+    try { count = appendBatch(tablename, records); }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
+    return count;
+}
+
+int API::appendBatch(const string &tablename, std::vector<Record> &records) {
+    const Table &table = CM->getTableInfo(tablename);
+    convertRecords(table, records);
+
+    //uniqueԽϵأͬһҲظ
+    auto less = [](const Value *lhs, const Value *rhs) { return *lhs < *rhs; };
+    for (size_t i = 0; i < table.attrs.size(); i++) {
+        const Attr &attr = table.attrs[i];
+        if (!attr.unique) continue;
+        const Index &index = getUniqueIndex(tablename, attr.name);
+        std::set<const Value*, decltype(less)> batch_values(less);
+        for (const auto &record : records) {
+            if (!batch_values.insert(&record[i]).second || findInIndex(tablename, index, attr.type, record[i])) {
+                throw MiniSQLException("Duplicate Value on Unique Attribute!");
+            }
+        }
+    }
+
+    std::vector<Position> poses;
+    int free_slot;
+    int appended = RM->insertRecords(tablename, table, records, poses, free_slot);
+    int reused = (int)records.size() - appended;
+    if (appended > 0) CM->increaseRecordCount(tablename, appended);
+    if (reused > 0) CM->reuseFreeSlot(tablename, free_slot, reused);
 
     const auto &indexes = CM->getIndexInfo(tablename);
     for (const auto &index : indexes) {
-        Type index_key_type;
-        value_ptr = record.begin();
-        for (const auto &key : index.keys) {
-            for (const auto &attr : table.attrs) {
-                if (attr.name == key) {
-                    index_key_type = attr.type;
-                    break;
-                }
-                value_ptr++;
+        size_t column = indexKeyColumn(table, index.keys);
+        auto update = [&](auto key) {
+            using KeyType = decltype(key);
+            std::vector<std::pair<KeyType, Position>> entries;
+            entries.reserve(records.size());
+            for (size_t i = 0; i < records.size(); i++) {
+                readKey(key, records[i][column].translate<char*>());
+                entries.push_back(std::make_pair(key, poses[i]));
             }
-        }
-        switch (index_key_type.btype) {
-        case BaseType::CHAR:    IM->insertIntoIndex<FLString>(tablename, index.name, index.rank, FLString(value_ptr->translate<char*>()),insertPos); break;
-        case BaseType::INT:    IM->insertIntoIndex<int>(tablename, index.name, index.rank, value_ptr->translate<int>(), insertPos); break;
-        case BaseType::FLOAT:    IM->insertIntoIndex<float>(tablename, index.name, index.rank, value_ptr->translate<float>(), insertPos); break;
+            IM->insertBatchIntoIndex<KeyType>(tablename, index.name, index.rank, entries);
+        };
+        switch (table.attrs[column].type.btype) {
+        case BaseType::CHAR:    IndexManager::dispatchCharKey(index.rank, update); break;
+        case BaseType::INT:    update(int()); break;
+        case BaseType::FLOAT:    update(float()); break;
         }
     }
+    return (int)records.size();
 }
 
 /*
@@ -227,11 +581,20 @@ create table table2 (
 );
 */
 
-SQLResult API::selectFromTable(const string &tablename, Predicate &pred) {
+//αпͱĶʱŷſ
+RecordCursor API::selectFromTable(const string &tablename, Predicate &pred, int parallelism) {
+    ReadLock catalog(catalog_lock);
+    ReadLock table(tableLock(tablename));
+    RecordCursor cursor = openCursor(tablename, pred, parallelism);
+    cursor.holdLock(std::move(table));
+    cursor.holdLock(std::move(catalog));
+    return cursor;
+}
+
+RecordCursor API::openCursor(const string &tablename, Predicate &pred, int parallelism) {
     checkPredicate(tablename, pred);
 
     const Table &table = CM->getTableInfo(tablename);
-    ReturnTable result;
 
     //
     const auto &indexes = CM->getIndexInfo(tablename);
@@ -251,35 +614,53 @@ SQLResult API::selectFromTable(const string &tablename, Predicate &pred) {
                 }
             }
 
+            //еĴʱضϺȽϲ׼
+            if (BaseType::CHAR == index_key_type.btype) {
+                size_t key_size = IndexManager::getCharKeySizeByRank(index.rank);
+                bool fits = true;
+                for (const auto &cond : pred_ptr->second) {
+                    if (strlen(cond.data.translate<char*>()) >= key_size) fits = false;
+                }
+                if (!fits) continue;
+            }
+
             vector<Position> possible_poses;
 
             //ϲ
             auto newCond = filterCondition(pred_ptr->second);
-            if (newCond.size() == 0) return SQLResult();
+            if (newCond.size() == 0) return RM->selectRecord(tablename, table, pred, possible_poses);//ìܣûн
             if(newCond.end() != newCond.find(Compare::EQ)) {
                 const Value &eqValue = *(newCond.find(Compare::EQ)->second.begin());
                 Position pos;
                 switch (index_key_type.btype) {
-                case BaseType::CHAR:    pos = IM->findOneFromIndex<FLString>(tablename, index.name, index.rank, eqValue.translate<char*>()); break;
+                case BaseType::CHAR:
+                    IndexManager::dispatchCharKey(index.rank, [&](auto key) {
+                        using KeyType = decltype(key);
+                        pos = IM->findOneFromIndex<KeyType>(tablename, index.name, index.rank, KeyType(eqValue.translate<char*>()));
+                    });
+                    break;
                 case BaseType::INT:    pos = IM->findOneFromIndex<int>(tablename, index.name, index.rank, eqValue.translate<int>()); break;
                 case BaseType::FLOAT:    pos = IM->findOneFromIndex<float>(tablename, index.name, index.rank, eqValue.translate<float>()); break;
                 }
-                possible_poses.push_back(pos);
+                if (-1 != pos.block_id) possible_poses.push_back(pos);
             } else {
                 switch (index_key_type.btype) {
-                case BaseType::CHAR: {
-                    std::pair<Compare, FLString> startKey = make_pair(Compare::EQ, FLString(""));
-                    std::pair<Compare, FLString> endKey = make_pair(Compare::EQ, FLString(""));
-                    std::set<FLString> neKeys;
-                    if (newCond.end() != newCond.find(Compare::GE)) startKey = make_pair(Compare::GE, FLString(newCond.find(Compare::GE)->second.begin()->translate<char*>()));
-                    else if (newCond.end() != newCond.find(Compare::GT)) startKey = make_pair(Compare::GT, FLString(newCond.find(Compare::GT)->second.begin()->translate<char*>()));
-                    if (newCond.end() != newCond.find(Compare::LE)) endKey = make_pair(Compare::LE, FLString(newCond.find(Compare::LE)->second.begin()->translate<char*>()));
-                    else if (newCond.end() != newCond.find(Compare::LT)) endKey = make_pair(Compare::LT, FLString(newCond.find(Compare::LT)->second.begin()->translate<char*>()));
-                    if (newCond.end() != newCond.find(Compare::NE)) {
-                        for (auto neKey : newCond.find(Compare::NE)->second) neKeys.insert(FLString(neKey.translate<char*>()));
-                    }
-                    IM->findRangeFromIndex<FLString>(tablename, index.name, index.rank, startKey, endKey, neKeys, possible_poses); break;
-                }
+                case BaseType::CHAR:
+                    IndexManager::dispatchCharKey(index.rank, [&](auto key) {
+                        using KeyType = decltype(key);
+                        std::pair<Compare, KeyType> startKey = make_pair(Compare::EQ, KeyType(""));
+                        std::pair<Compare, KeyType> endKey = make_pair(Compare::EQ, KeyType(""));
+                        std::set<KeyType> neKeys;
+                        if (newCond.end() != newCond.find(Compare::GE)) startKey = make_pair(Compare::GE, KeyType(newCond.find(Compare::GE)->second.begin()->translate<char*>()));
+                        else if (newCond.end() != newCond.find(Compare::GT)) startKey = make_pair(Compare::GT, KeyType(newCond.find(Compare::GT)->second.begin()->translate<char*>()));
+                        if (newCond.end() != newCond.find(Compare::LE)) endKey = make_pair(Compare::LE, KeyType(newCond.find(Compare::LE)->second.begin()->translate<char*>()));
+                        else if (newCond.end() != newCond.find(Compare::LT)) endKey = make_pair(Compare::LT, KeyType(newCond.find(Compare::LT)->second.begin()->translate<char*>()));
+                        if (newCond.end() != newCond.find(Compare::NE)) {
+                            for (auto neKey : newCond.find(Compare::NE)->second) neKeys.insert(KeyType(neKey.translate<char*>()));
+                        }
+                        IM->findRangeFromIndex<KeyType>(tablename, index.name, index.rank, startKey, endKey, neKeys, possible_poses);
+                    });
+                    break;
                 case BaseType::INT: {
                     std::pair<Compare, int> startKey = make_pair(Compare::EQ, 0);
                     std::pair<Compare, int> endKey = make_pair(Compare::EQ, 0);
@@ -310,46 +691,60 @@ SQLResult API::selectFromTable(const string &tablename, Predicate &pred) {
             }
 
             pred.erase(pred_ptr);
-            result = RM->selectRecord(tablename, table, pred, possible_poses);
-            return SQLResult{ table, result };
+            return RM->selectRecord(tablename, table, pred, possible_poses);
         }
     }
 
-    result = RM->selectRecord(tablename, table, pred);
-    return SQLResult{ table, result };
+    return RM->selectRecord(tablename, table, pred, parallelism);
 }
 
 int API::deleteFromTable(const string &tablename, Predicate &pred) {
-    checkPredicate(tablename, pred);
-
-    const Table &table = CM->getTableInfo(tablename);
-    SQLResult records = selectFromTable(tablename, pred);
-    const ReturnTable &result = records.ret;
-    for (const auto &record : result) RM->deleteRecord(tablename, record.pos);
-
-    const auto &indexes = CM->getIndexInfo(tablename);
-    for (const auto &index : indexes) {
-        Type index_key_type;
-        for (const auto &record : result) {
-            auto value_ptr = record.content.begin();
-            for (const auto &key : index.keys) {
-                for (const auto &attr : table.attrs) {
-                    if (attr.name == key) {
-                        index_key_type = attr.type;
-                        break;
-                    }
-                    value_ptr++;
+    ReadLock catalog(catalog_lock);
+    WriteLock lock(tableLock(tablename));
+    Statement statement(this, tablename);
+    int count = 0;
+    try {
+        checkPredicate(tablename, pred);
+
+        //ɨɾɨĲ۲ٱʣλҲȡ
+        const Table &table = CM->getTableInfo(tablename);
+        const auto &indexes = CM->getIndexInfo(tablename);
+        std::vector<size_t> index_columns;//ڵ
+        for (const auto &index : indexes) index_columns.push_back(indexKeyColumn(table, index.keys));
+        RecordCursor cursor = openCursor(tablename, pred, 1);
+        RowView row;
+        Position pos;
+        while (cursor.next(row, pos)) {
+            //ɾ¼дò۵ݣȰͼɾеļ
+            for (size_t i = 0; i < indexes.size(); i++) {
+                const Index &index = indexes[i];
+                size_t column = index_columns[i];
+                switch (table.attrs[column].type.btype) {
+                case BaseType::CHAR:
+                    IndexManager::dispatchCharKey(index.rank, [&](auto key) {
+                        using KeyType = decltype(key);
+                        IM->removeFromIndex<KeyType>(tablename, index.name, index.rank, KeyType(row.getChar(column)));
+                    });
+                    break;
+                case BaseType::INT:    IM->removeFromIndex<int>(tablename, index.name, index.rank, row.getInt(column)); break;
+                case BaseType::FLOAT:    IM->removeFromIndex<float>(tablename, index.name, index.rank, row.getFloat(column)); break;
                 }
             }
-            switch (index_key_type.btype) {
-            case BaseType::CHAR:    IM->removeFromIndex<FLString>(tablename, index.name, index.rank, FLString(value_ptr->translate<char*>())); break;
-            case BaseType::INT:    IM->removeFromIndex<int>(tablename, index.name, index.rank, value_ptr->translate<int>()); break;
-            case BaseType::FLOAT:    IM->removeFromIndex<float>(tablename, index.name, index.rank, value_ptr->translate<float>()); break;
-            }
+            CM->releaseSlot(tablename, RM->deleteRecord(tablename, table, pos));
+            count++;
         }
     }
+    catch (...) {
+        statement.commit();
+        throw;
+    }
+    statement.commit();
+    return count;
+}
 
-    return result.size();
+void API::resizeBuffer(size_t pool_size) {
+    WriteLock catalog(catalog_lock);
+    BM->resize(pool_size);
 }
 
 void API_test() {
@@ -357,11 +752,91 @@ void API_test() {
     CatalogManager CM(META_TABLE_FILE_PATH, META_INDEX_FILE_PATH);
     RecordManager RM(&BM);
     IndexManager IM(&BM);
-    API core(&CM, &RM, &IM);
+    API core(&CM, &RM, &IM, &BM);
     try {
         core.createIndex("table1", "index1", { "a" });
         core.dropIndex("table1", "index1");
     } catch (MiniSQLException &e) {
         std::cout << e.getMessage() << std::endl;
     }
-}
\ No newline at end of file
+}
+/*
+ָԣ벢ɾһֺ㣬еҳϢ൱ڽ̱
+ٰ־ָ¼ʱ׳쳣
+*/
+void Recovery_test() {
+    const string tablename = "recovery_test";
+    const int count = 2000, deleted = 500;
+    auto idIs = [](Compare comp, int id) {
+        Predicate pred;
+        pred["id"].push_back({ comp, Value(Type(BaseType::INT, 4), &id) });
+        return pred;
+    };
+    {
+        LogManager LM;
+        BufferManager BM(DEFAULT_POOL_SIZE, ReplacePolicy::CLOCK, &LM);
+        CatalogManager *CM = new CatalogManager(META_TABLE_FILE_PATH, META_INDEX_FILE_PATH);//ʱ棬ⲻ
+        LM.recover(CM);
+        RecordManager RM(&BM);
+        IndexManager IM(&BM);
+        API core(CM, &RM, &IM, &BM, &LM);
+        try { core.dropTable(tablename); }
+        catch (MiniSQLException &) {}
+        core.checkpoint();
+
+        core.createTable(tablename, { { "id", Type(BaseType::INT, 4), true }, { "name", Type(BaseType::CHAR, 16), false } }, { "id" });
+        std::vector<Record> records;
+        for (int i = 0; i < count; i++) {
+            string name = "name" + std::to_string(i);
+            records.push_back({ Value(Type(BaseType::INT, 4), &i), Value(Type(BaseType::CHAR, name.size() + 1), name.data()) });
+        }
+        core.insertBatch(tablename, records);
+        Predicate pred = idIs(Compare::LT, deleted);
+        core.deleteFromTable(tablename, pred);
+
+        BM.setEmpty("../" + tablename + ".table");
+        BM.setEmpty(INDEX_FILE_PATH(tablename, "PRIMARY_KEY"));
+    }
+
+    LogManager LM;
+    BufferManager BM(DEFAULT_POOL_SIZE, ReplacePolicy::CLOCK, &LM);
+    CatalogManager CM(META_TABLE_FILE_PATH, META_INDEX_FILE_PATH);
+    LM.recover(&CM);
+    RecordManager RM(&BM);
+    IndexManager IM(&BM);
+    API core(&CM, &RM, &IM, &BM, &LM);
+
+    std::vector<bool> found(count, false);
+    int rows = 0, wrong = 0;
+    {
+        Predicate all;
+        RecordCursor cursor = core.selectFromTable(tablename, all);
+        RowView row;
+        Position pos;
+        while (cursor.next(row, pos)) {
+            int id = row.getInt(0);
+            if (id < deleted || id >= count || found[id] || string(row.getChar(1)) != "name" + std::to_string(id)) {
+                std::cout << "Wrong Row: " << id << std::endl;
+                wrong++;
+                continue;
+            }
+            found[id] = true;
+            rows++;
+        }
+    }
+    for (int id : { 0, deleted - 1, deleted, count / 2, count - 1 }) {
+        Predicate pred = idIs(Compare::EQ, id);
+        RecordCursor cursor = core.selectFromTable(tablename, pred);
+        RowView row;
+        Position pos;
+        bool hit = cursor.next(row, pos);
+        if (hit != (id >= deleted)) {
+            std::cout << "Wrong Index Lookup: " << id << std::endl;
+            wrong++;
+        }
+    }
+    std::cout << "Recovered " << rows << " of " << count - deleted << " Rows" << std::endl;
+    core.dropTable(tablename);
+    core.checkpoint();
+    if (wrong > 0 || rows != count - deleted) throw MiniSQLException("Recovery Test Failed!");
+}
@@ -2,31 +2,101 @@
 #include "MiniSQLCatalogManager.h"
 #include "MiniSQLRecordManager.h"
 #include "MiniSQLIndexManager.h"
+#include "MiniSQLLoader.h"
+#include "MiniSQLLogManager.h"
 #include "MiniSQLException.h"
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
 using std::string;
 
-struct SQLResult {
-    Table table;
-    ReturnTable ret;
-};
+#define LOAD_BATCH_SIZE 4096   //ʱÿļ¼
+
+/*
+ỰͬʱAPIÿűһѶдѯֱֶαԱĲд
+ԱǰȳĶɾvacuum͵صҪֿд
+־ʱÿ޸ݵһ񣬷ǰ޸̵־
+̨㲻ֿͬʱ
+*/
 
 class API {
 public:
-    API(CatalogManager *CM, RecordManager *RM, IndexManager *IM) : CM(CM), RM(RM), IM(IM) {}
+    API(CatalogManager *CM, RecordManager *RM, IndexManager *IM, BufferManager *BM, LogManager *LM = nullptr)
+        : stopping(false), CM(CM), RM(RM), IM(IM), BM(BM), LM(LM) {}
+    ~API();
 
     void createTable(const string &tablename, const std::vector<Attr> &attrs, const set<string> &primary_key);
     void dropTable(const string &tablename);
     void createIndex(const string &tablename, const string &indexname, const set<string> &keys);
     void dropIndex(const string &tablename, const string &indexname);
     void insertIntoTable(const string &tablename, Record &record);
-    SQLResult selectFromTable(const string &tablename, Predicate &pred);
+    int insertBatch(const string &tablename, std::vector<Record> &records);
+    int loadData(const string &tablename, const string &filename, bool binary, bool defer_index);
+    //òʱȫɨ裬parallelismΪɨ߳
+    RecordCursor selectFromTable(const string &tablename, Predicate &pred, int parallelism = 1);
     int deleteFromTable(const string &tablename, Predicate &pred);
+    long long vacuumTable(const string &tablename);
+    void resizeBuffer(size_t pool_size);
+    void setFillFactor(double fill);
+    //㣺дҳϢȻ־֮ǰ̨ʱ׳ô
+    void checkpoint();
+    //̨̣߳ÿһʱ־һСʱһ
+    void startCheckpointer(const FlushConfig &config);
 
 private:
+    typedef std::shared_timed_mutex RWLock;
+    typedef std::shared_lock<RWLock> ReadLock;
+    typedef std::unique_lock<RWLock> WriteLock;
+    RWLock catalog_lock;
+    std::mutex table_locks_lock;
+    std::map<string, std::unique_ptr<RWLock>> table_locks;
+    RWLock &tableLock(const string &tablename);
+
+    //²ɵ߳
+    void addIndex(const string &tablename, const string &indexname, const set<string> &keys);
+    int appendBatch(const string &tablename, std::vector<Record> &records);
+    RecordCursor openCursor(const string &tablename, Predicate &pred, int parallelism);
+    void writeCheckpoint();
+
+    //㻥ų
+    std::mutex checkpoint_lock;
+    void fuzzyCheckpoint(int pages_per_second);
+    void checkpointLoop(FlushConfig config);
+    std::thread checkpointer;
+    std::mutex checkpointer_lock;
+    std::condition_variable checkpointer_wake;
+    bool stopping;
+    std::exception_ptr checkpoint_error;//̨쳣һcheckpoint()׳
+
+    //һ޸ݵΪһ񣬽ʱҲһɵcommitѱϢд־ύ־̡
+    //ύʱ쳣׸ߣʱύ
+    class Statement {
+    public:
+        Statement(API *api, const string &tablename);
+        Statement(const Statement &) = delete;
+        void commit();
+    private:
+        API *api;
+        string tablename;
+        int txn;
+        bool done;
+    };
+
     CatalogManager *CM;
     RecordManager *RM;
     IndexManager *IM;
+    BufferManager *BM;
+    LogManager *LM;
 
     void checkPredicate(const string &tablename, const Predicate &pred) const;
     std::map<Compare, std::set<Value>> filterCondition(const std::vector<Condition> &conds) const;
+    size_t indexKeyColumn(const Table &table, const set<string> &keys) const;
+    void locateIndexKey(const Table &table, const set<string> &keys, Type &key_type, size_t &key_offset) const;
+    void buildIndex(const string &tablename, const string &indexname, int rank, const Type &key_type, size_t key_offset);
+    void rebuildIndexes(const string &tablename);
+    void convertRecords(const Table &table, std::vector<Record> &records) const;
+    const Index &getUniqueIndex(const string &tablename, const string &attrname);
+    bool findInIndex(const string &tablename, const Index &index, const Type &type, const Value &value);
 };
\ No newline at end of file
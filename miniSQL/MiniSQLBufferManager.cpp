@@ -1,186 +1,1004 @@
 #include "MiniSQLBufferManager.h"
+#include "MiniSQLLogManager.h"
 #include "MiniSQLException.h"
 #include <iostream>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#define INVALID_FILE_HANDLE INVALID_HANDLE_VALUE
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define INVALID_FILE_HANDLE (-1)
+#endif
+
+//ǰ߳ڽе0ʾû
+static thread_local int current_txn = 0;
+
+//ƫʵʶֻֽļĩβʱlength׳쳣
+static size_t readAt(FileHandle fd, char *buffer, size_t length, long long offset) {
+    size_t total = 0;
+    while (total < length) {
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        ov.Offset = (DWORD)((offset + total) & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)((offset + total) >> 32);
+        DWORD read = 0;
+        if (!ReadFile(fd, buffer + total, (DWORD)(length - total), &read, &ov)) {
+            if (GetLastError() != ERROR_HANDLE_EOF) throw MiniSQLException("Fail to read file!");
+            read = 0;
+        }
+#else
+        ssize_t read = pread(fd, buffer + total, length - total, offset + total);
+        if (read < 0) {
+            if (errno == EINTR) continue;
+            throw MiniSQLException("Fail to read file!");
+        }
+#endif
+        if (read == 0) break;//ļĩβ
+        total += read;
+    }
+    return total;
+}
+
+//ƫдǷд
+static bool writeAt(FileHandle fd, const char *buffer, size_t length, long long offset) {
+#ifdef _WIN32
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD written = 0;
+    return WriteFile(fd, buffer, (DWORD)length, &written, &ov) && written == length;
+#else
+    return pwrite(fd, buffer, length, offset) == (ssize_t)length;
+#endif
+}
+
+//䰴ҳҳ飬ʹôҳ
+static char *allocArena(size_t size) {
+#ifdef _WIN32
+    SIZE_T large = GetLargePageMinimum();
+    if (large != 0 && size % large == 0) {//ҪSeLockMemoryPrivilegeȨޣʧ˻ͨҳ
+        void *p = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p != NULL) return (char*)p;
+    }
+    void *p = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    return (char*)p;
+#else
+    //ӳһҳԱ룬ͷĲֻȥ
+    size_t mapped = size + HUGEPAGESIZE;
+    void *p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+    uintptr_t base = (uintptr_t)p;
+    uintptr_t aligned = (base + HUGEPAGESIZE - 1) & ~(uintptr_t)(HUGEPAGESIZE - 1);
+    if (aligned > base) munmap(p, aligned - base);
+    if (base + mapped > aligned + size) munmap((void*)(aligned + size), base + mapped - aligned - size);
+#ifdef MADV_HUGEPAGE
+    madvise((void*)aligned, size, MADV_HUGEPAGE);
+#endif
+    return (char*)aligned;
+#endif
+}
+
+static void freeArena(char *arena, size_t size) {
+    if (arena == nullptr) return;
+#ifdef _WIN32
+    VirtualFree(arena, 0, MEM_RELEASE);
+#else
+    munmap(arena, size);
+#endif
+}
+
+static bool syncHandle(FileHandle fd) {
+#ifdef _WIN32
+    return FlushFileBuffers(fd) != 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+//ļ򿪲ˢ̣ļѲʱ
+static bool syncByName(const string &filename) {
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fd == INVALID_HANDLE_VALUE) return true;
+    bool ok = FlushFileBuffers(fd) != 0;
+    CloseHandle(fd);
+#else
+    int fd = open(filename.c_str(), O_RDWR);
+    if (fd == -1) return true;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+#endif
+    return ok;
+}
+
+//ļ
+static long long fileSize(FileHandle fd) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fd, &size)) return -1;
+    return size.QuadPart;
+#else
+    return lseek(fd, 0, SEEK_END);
+#endif
+}
+
+//ֻӳļʷʽʾԤ
+static char *mapFile(FileHandle fd, long long size, AccessPattern pattern) {
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(fd, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) return nullptr;
+    char *addr = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T)size);
+    CloseHandle(mapping);//ͼǰӳ󲻻ͷ
+    return addr;
+#else
+    void *addr = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) return nullptr;
+    madvise(addr, (size_t)size, (AccessPattern::RANDOM == pattern) ? MADV_RANDOM : MADV_SEQUENTIAL);
+    return (char*)addr;
+#endif
+}
+
+static void unmapFile(char *addr, long long size) {
+#ifdef _WIN32
+    UnmapViewOfFile(addr);
+#else
+    munmap(addr, (size_t)size);
+#endif
+}
+
+//ʾϵͳЩҪWindows²
+static void adviseWillNeed(char *addr, long long length) {
+#ifndef _WIN32
+    madvise(addr, (size_t)length, MADV_WILLNEED);
+#endif
+}
 
 BufferManager::Page::Page() {
-    filename = "";
+    buffer = nullptr;
+    file_id = -1;
     block_id = -1;//ļǵ0鿪ʼ
     dirty = false;
-    pin = false;
-    ref = false;
+    pin_count = 0;
     empty = true;
-    memset(buffer, 0, sizeof(char)*PAGESIZE);
+    loading = false;
+    txn = 0;
+    lsn = 0;
+    rec_lsn = 0;
+    writing = false;
+    prefetched = false;
+    failed = false;
 }
 
-//캯(ʼҳ)
-BufferManager::BufferManager(int page_num) {
-    frame = new Page[page_num];
-    this->page_num = page_num;
-    replace_position = 0;
+//ϣȡС2ҳ2ݣ֤װʲһ
+BufferManager::PageTable::PageTable(int page_num) {
+    int capacity = 16;
+    while (capacity < page_num * 2) capacity <<= 1;
+    keys.assign(capacity, -1);
+    pages.assign(capacity, -1);
+    mask = capacity - 1;
 }
 
-//:ȫдش
+int BufferManager::PageTable::slotOf(long long key) const {
+    unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+    return (int)(h >> 32) & mask;
+}
+
+//(ļ,)Ӧҳţڷ-1
+int BufferManager::PageTable::find(int file_id, int block_id) const {
+    long long key = makeKey(file_id, block_id);
+    for (int i = slotOf(key); keys[i] != -1; i = (i + 1) & mask) {
+        if (keys[i] == key) return pages[i];
+    }
+    return -1;
+}
+
+void BufferManager::PageTable::insert(int file_id, int block_id, int page_id) {
+    long long key = makeKey(file_id, block_id);
+    int i = slotOf(key);
+    while (keys[i] != -1 && keys[i] != key) i = (i + 1) & mask;
+    keys[i] = key;
+    pages[i] = page_id;
+}
+
+//ɾ̽ϺǰƣĹ
+void BufferManager::PageTable::erase(int file_id, int block_id) {
+    long long key = makeKey(file_id, block_id);
+    int i = slotOf(key);
+    while (keys[i] != key) {
+        if (keys[i] == -1) return;
+        i = (i + 1) & mask;
+    }
+    int j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (keys[j] == -1) break;
+        int home = slotOf(keys[j]);
+        //home(i,j]֮ʱjƵi
+        if ((i < j) ? (home <= i || home > j) : (home <= i && home > j)) {
+            keys[i] = keys[j];
+            pages[i] = pages[j];
+            i = j;
+        }
+    }
+    keys[i] = -1;
+    pages[i] = -1;
+}
+
+//캯(ֽʼҳ)
+BufferManager::BufferManager(size_t pool_size, ReplacePolicy policy, LogManager *log)
+    : page_num(0), arena(nullptr), arena_size(0), frame(nullptr), pageTable(MINPAGENUM), policy(policy), replacer(nullptr)
+    , mapped_reads(false), log(log), stopping(false), writing_count(0), prefetch_count(0)
+{
+    initPool(pool_size);
+    hit_count = miss_count = 0;
+}
+
+//:ֹ̨ͣдȫдش
 BufferManager::~BufferManager() {
+    {
+        Lock lock(latch);
+        stopping = true;
+    }
+    writer_wake.notify_all();
+    if (writer.joinable()) writer.join();
+    prefetcher.reset();//ύԤ
+    releasePool();
+    for (int i = 0; i < (int)files.size(); i++) closeFile(i);
+}
+
+/*
+ҳҳϢҳֽ
+µҳ顢ҳϢҳ滻ԶԺдزͷԭеĻأʧܻдسʱԭز
+*/
+void BufferManager::initPool(size_t pool_size) {
+    size_t pages = pool_size / PAGESIZE;
+    if (pages < MINPAGENUM) throw MiniSQLException("Buffer Pool Too Small!");
+    if (pages > INT_MAX / 2) throw MiniSQLException("Buffer Pool Too Large!");
+
+    size_t new_arena_size = (pages * PAGESIZE + HUGEPAGESIZE - 1) / HUGEPAGESIZE * HUGEPAGESIZE;
+    char *new_arena = allocArena(new_arena_size);
+    if (new_arena == nullptr) throw MiniSQLException("Fail to allocate buffer pool!");
+    std::unique_ptr<Page[]> new_frame;
+    std::unique_ptr<Replacer> new_replacer;
+    PageTable new_table(MINPAGENUM);
+    try {
+        new_frame.reset(new Page[pages]);
+        new_replacer.reset(Replacer::create(policy, (int)pages));
+        new_table = PageTable((int)pages);
+        releasePool();
+    }
+    catch (std::bad_alloc &) {
+        freeArena(new_arena, new_arena_size);
+        throw MiniSQLException("Fail to allocate buffer pool!");
+    }
+    catch (...) {
+        freeArena(new_arena, new_arena_size);
+        throw;
+    }
+
+    page_num = (int)pages;
+    arena = new_arena;
+    arena_size = new_arena_size;
+    frame = new_frame.release();
+    for (int i = 0; i < page_num; i++) frame[i].buffer = arena + (size_t)i * PAGESIZE;
+    pageTable = std::move(new_table);
+    freePages.clear();
+    for (int i = page_num - 1; i >= 0; i--) freePages.push_back(i);
+    replacer = new_replacer.release();
+}
+
+//дȫҳͷҳ
+void BufferManager::releasePool() {
     for (int i = 0; i < page_num; i++) {//ÿһҳдÿһ
-        if(frame[i].dirty) writeBackToDisk(i, frame[i].filename, frame[i].block_id);
+        if(frame[i].dirty) writeBackToDisk(i, frame[i].file_id, frame[i].block_id);
     }
     delete[] frame;
+    delete replacer;
+    freeArena(arena, arena_size);
+    page_num = 0;
+    frame = nullptr;
+    replacer = nullptr;
+    arena = nullptr;
+}
+
+//شСԭеҳȫдغգµĻطʧʱԭ
+void BufferManager::resize(size_t pool_size) {
+    Lock lock(latch);
+    size_t pages = pool_size / PAGESIZE;
+    if (pages < MINPAGENUM) throw MiniSQLException("Buffer Pool Too Small!");
+    loaded.wait(lock, [this] { return writing_count == 0 && prefetch_count == 0; });
+    for (int i = 0; i < page_num; i++) {
+        if (frame[i].pin_count > 0) throw MiniSQLException("Buffer Pool In Use!");
+    }
+    initPool(pool_size);
 }
 
-//ȡļпӦڴҳ(ûҵ͵һҳ)
-int BufferManager::getPageID(const string &filename, int block_id) {
-    auto id = nameID.find(make_pair(filename,block_id));
-    if (nameID.end() != id) return (*id).second;
-    
+//ǼļļţѵǼֱӷأ
+int BufferManager::registerFile(const string &filename, AccessPattern pattern) {
+    Lock lock(latch);
+    auto it = fileID.find(filename);
+    if (fileID.end() != it) return it->second;
+
+    int file_id = 0;
+    while (file_id < (int)files.size() && files[file_id].used) file_id++;
+    if (file_id == (int)files.size()) files.push_back(File());
+    files[file_id] = File();
+    files[file_id].filename = filename;
+    files[file_id].fd = INVALID_FILE_HANDLE;
+    files[file_id].used = true;
+    files[file_id].pattern = pattern;
+    files[file_id].map = { nullptr, 0 };
+    files[file_id].map_pins = 0;
+    fileID[filename] = file_id;
+    return file_id;
+}
+
+//ȡļδ
+FileHandle BufferManager::openFile(int file_id) {
+    File &file = files[file_id];
+    if (file.fd != INVALID_FILE_HANDLE) return file.fd;
+
+#ifdef _WIN32
+    file.fd = CreateFileA(file.filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    file.fd = open(file.filename.c_str(), O_RDWR);
+#endif
+    if (file.fd == INVALID_FILE_HANDLE) throw MiniSQLException("Fail to open file!"); //ļʧ
+    return file.fd;
+}
+
+//ӳ䣬رļ
+void BufferManager::closeFile(int file_id) {
+    File &file = files[file_id];
+    if (file.map.addr != nullptr) file.retired.push_back(file.map);
+    for (const auto &map : file.retired) unmapFile(map.addr, map.size);
+    file.retired.clear();
+    file.map = { nullptr, 0 };
+    if (file.fd == INVALID_FILE_HANDLE) return;
+#ifdef _WIN32
+    CloseHandle(file.fd);
+#else
+    close(file.fd);
+#endif
+    file.fd = INVALID_FILE_HANDLE;
+}
+
+/*
+ȡĳڵҳסʱҳ̶߳룬ꣻ
+δʱlatchռһҳǼǡסſlatchٶ̣ڼ߳̿ճȡҳ
+ԤװҳһαȡʱδУ滻Ҳװ
+*/
+PageGuard BufferManager::fetchPage(int file_id, int block_id, PageIntent intent) {
+    Lock lock(latch);
+    int page_id = pageTable.find(file_id, block_id);
+    if (-1 != page_id) {
+        if (frame[page_id].prefetched) {
+            frame[page_id].prefetched = false;
+            miss_count++;
+            replacer->recordLoad(page_id);
+        }
+        else {
+            hit_count++;
+            replacer->recordAccess(page_id);
+        }
+        pinPage(page_id, intent);
+        loaded.wait(lock, [&] { return !frame[page_id].loading; });
+        if (frame[page_id].failed) {
+            releaseFailed(page_id);
+            throw MiniSQLException("Fail to read file!");
+        }
+        return PageGuard(this, page_id);
+    }
+
+    //ֻʱֱӶӳ䣬ռ
+    if (PageIntent::READ_ONLY == intent && mapped_reads) {
+        char *head = mapBlock(file_id, block_id);
+        if (head != nullptr) {
+            files[file_id].map_pins++;
+            return PageGuard(this, file_id, head);
+        }
+    }
+
     //bufferӦ
-    int page_id = getEmptyPage();
-    loadBlockToPage(page_id, filename, block_id);
-    return page_id;
+    miss_count++;
+    FileHandle fd = openFile(file_id);
+    page_id = getEmptyPage();
+    mapPage(page_id, file_id, block_id);
+    frame[page_id].loading = true;
+    pinPage(page_id, intent);
+    lock.unlock();
+
+    //ƫƶȡļĩβĲֲ0̳ʱҳãһҳ߳Ҳ׳쳣
+    char *head = frame[page_id].buffer;
+    try {
+        size_t read = readAt(fd, head, PAGESIZE, (long long)PAGESIZE * block_id);
+        memset(head + read, 0, PAGESIZE - read);
+    }
+    catch (MiniSQLException &) {
+        lock.lock();
+        frame[page_id].loading = false;
+        frame[page_id].failed = true;
+        releaseFailed(page_id);
+        loaded.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    frame[page_id].loading = false;
+    loaded.notify_all();
+    return PageGuard(this, page_id);
 }
 
-//ȡĳҳݣֱʹļ
-char* BufferManager::getBlockContent(const string &filename, int block_id) {
-    int page_id = getPageID(filename, block_id);
-    char* head = frame[page_id].buffer;
-    frame[page_id].ref = true;
-    return head;
+void BufferManager::enableMappedReads() {
+    Lock lock(latch);
+    mapped_reads = true;
 }
 
-//ȡĳҳݣʹҳţ
-char* BufferManager::getBlockContent(int page_id) {
-    char* head = frame[page_id].buffer;
-    frame[page_id].ref = true;
-    return head;
+/*
+ӳ䰴ʱļȽ֮ļ䳤׷˿飩ʱ³ӳ䡣
+ӳܻҳָûоָӳʱٽ
+*/
+char *BufferManager::mapBlock(int file_id, int block_id) {
+    File &file = files[file_id];
+    long long end = (long long)PAGESIZE * (block_id + 1);
+    if (end > file.map.size) {
+        long long size = fileSize(openFile(file_id));
+        if (end > size) return nullptr;
+        char *addr = mapFile(file.fd, size, file.pattern);
+        if (addr == nullptr) return nullptr;
+        if (file.map.addr != nullptr) file.retired.push_back(file.map);
+        if (file.map_pins == 0) {
+            for (const auto &map : file.retired) unmapFile(map.addr, map.size);
+            file.retired.clear();
+        }
+        file.map = { addr, size };
+    }
+    return file.map.addr + (long long)PAGESIZE * block_id;
 }
 
-//޸ĳҳݣֱʹļ
-void BufferManager::setBlockContent(const string &filename, int block_id, int offset, char* data, size_t length) {
-    int page_id = getPageID(filename, block_id);
-    if (frame[page_id].empty == true) throw MiniSQLException("Empty Page!");
-    if (offset >= PAGESIZE) throw MiniSQLException("Write Page Out of range!");
-    memcpy_s(frame[page_id].buffer + offset, PAGESIZE - offset, data, length);
-    frame[page_id].dirty = true;
-    frame[page_id].ref = true;
+void BufferManager::unpinMapped(int file_id) {
+    Lock lock(latch);
+    File &file = files[file_id];
+    if (--file.map_pins > 0) return;
+    for (const auto &map : file.retired) unmapFile(map.addr, map.size);
+    file.retired.clear();
+}
+
+void BufferManager::prefetch(int file_id, int block_id, int count) {
+    if (count <= 0) return;
+    vector<int> block_ids;
+    for (int i = 0; i < count; i++) block_ids.push_back(block_id + i);
+    prefetch(file_id, block_ids);
+}
+
+/*
+ԤlatchռһҳǼǲסΪڶ룬̳̽߳أ
+ȡҳ߳һҳʱ꣬һ߳ڶʱһ
+*/
+void BufferManager::prefetch(int file_id, const vector<int> &block_ids) {
+    Lock lock(latch);
+    if (mapped_reads) {//ӳʱϵͳԤ
+        for (int block_id : block_ids) {
+            if (block_id < 0 || pageTable.find(file_id, block_id) != -1) continue;
+            char *head = mapBlock(file_id, block_id);
+            if (head != nullptr) adviseWillNeed(head, PAGESIZE);
+        }
+        return;
+    }
+    FileHandle fd = openFile(file_id);
+    long long block_num = fileSize(fd) / PAGESIZE;
+    if (!prefetcher) prefetcher.reset(new ThreadPool(PREFETCH_THREADS));
+    for (int block_id : block_ids) {
+        if (prefetch_count >= page_num / 4) break;
+        if (block_id < 0 || block_id >= block_num || pageTable.find(file_id, block_id) != -1) continue;
+        int page_id;
+        try { page_id = getEmptyPage(); }
+        catch (MiniSQLException &) { break; }//ҳסˣԤ
+        mapPage(page_id, file_id, block_id);
+        frame[page_id].loading = true;
+        frame[page_id].prefetched = true;
+        frame[page_id].pin_count++;
+        prefetch_count++;
+        long long offset = (long long)PAGESIZE * block_id;
+        prefetcher->submit([this, page_id, fd, offset] { loadPage(page_id, fd, offset); });
+    }
 }
 
-//޸ĳҳݣʹҳţ
-void BufferManager::setBlockContent(int page_id, int offset, char* data, size_t length) {
+//Ԥִ߳У̺ס̳ʱ׳֮ȡһҳ̵߳õ쳣
+void BufferManager::loadPage(int page_id, FileHandle fd, long long offset) {
+    char *head = frame[page_id].buffer;
+    bool failed = false;
+    try {
+        size_t read = readAt(fd, head, PAGESIZE, offset);
+        memset(head + read, 0, PAGESIZE - read);
+    }
+    catch (MiniSQLException &) { failed = true; }
+
+    Lock lock(latch);
+    frame[page_id].loading = false;
+    prefetch_count--;
+    if (failed) {
+        frame[page_id].failed = true;
+        releaseFailed(page_id);
+    }
+    else frame[page_id].pin_count--;
+    loaded.notify_all();
+}
+
+//סдʽͬʱҳ
+void BufferManager::pinPage(int page_id, PageIntent intent) {
     if (frame[page_id].empty == true) throw MiniSQLException("Empty Page!");
-    if (offset >= PAGESIZE) throw MiniSQLException("Write Page Out of range!");
-    memcpy_s(frame[page_id].buffer + offset, PAGESIZE - offset, data, length);
+    frame[page_id].pin_count++;
+    if (PageIntent::WRITE == intent) {
+        frame[page_id].dirty = true;
+        tagPage(page_id);
+    }
+}
+
+void BufferManager::unpinPage(int page_id) {
+    Lock lock(latch);
+    if (frame[page_id].pin_count > 0) frame[page_id].pin_count--;
+}
+
+void BufferManager::setDirty(int page_id) {
+    Lock lock(latch);
     frame[page_id].dirty = true;
-    frame[page_id].ref = true;
+    tagPage(page_id);
+}
+
+//ҳڵǰ̵߳
+void BufferManager::tagPage(int page_id) {
+    if (current_txn == 0 || frame[page_id].txn == current_txn) return;
+    frame[page_id].txn = current_txn;
+    txn_pages[current_txn].push_back(page_id);
 }
 
 //ļ¿һ飬ضӦĿ
-int BufferManager::allocNewBlock(const string &filename) {
+int BufferManager::allocNewBlock(int file_id) {
+    Lock lock(latch);
+    FileHandle fd = openFile(file_id);
     int page_id = getEmptyPage();
 
-    FILE* fp;
-    fopen_s(&fp, filename.c_str(), "rb+");
-    if (fp == nullptr) throw MiniSQLException("Fail to open file!"); //ļʧ
-    fseek(fp, 0, SEEK_END);
-    int block_id = ftell(fp) / PAGESIZE;
-    char blank[PAGESIZE] = { 0 };
-    fwrite(blank, sizeof(blank[0]), sizeof(blank), fp);
+    //ļĩβ׷һտ
+    int block_id = (int)(fileSize(fd) / PAGESIZE);
+    char *head = frame[page_id].buffer;
+    memset(head, 0, PAGESIZE);
+    if (!writeAt(fd, head, PAGESIZE, (long long)PAGESIZE * block_id)) throw MiniSQLException("Fail to write file!");
+    mapPage(page_id, file_id, block_id);
+    return block_id;
+}
+
+int BufferManager::getBlockCount(int file_id) {
+    Lock lock(latch);
+    return (int)(fileSize(openFile(file_id)) / PAGESIZE);
+}
+
+//ĳļصҳر
+void BufferManager::setEmpty(const string &filename) {
+    Lock lock(latch);
+    loaded.wait(lock, [this] { return writing_count == 0 && prefetch_count == 0; });
+    auto it = fileID.find(filename);
+    if (fileID.end() == it) return;
+    int file_id = it->second;
+
+    if (files[file_id].map_pins > 0) throw MiniSQLException("Page In Use!");
+    for (int i = 0; i < page_num; i++) {
+        if (frame[i].file_id == file_id && frame[i].pin_count > 0) throw MiniSQLException("Page In Use!");
+    }
+    for (int i = 0; i < page_num; i++) {
+        if (frame[i].file_id == file_id && !frame[i].empty) unmapPage(i);
+    }
+    closeFile(file_id);
+    files[file_id].used = false;
+    fileID.erase(it);
+}
+
+//½ļǷ񴴽ɹ
+bool BufferManager::createFile(const string &filename) {
+    FILE *fp;
+    fopen_s(&fp, filename.data(), "w");
+    if (fp == nullptr) return false;
     fclose(fp);
+    if (log != nullptr && current_txn != 0) log->logCreate(current_txn, filename);
+    return true;
+}
 
-    frame[page_id].filename = filename;
-    frame[page_id].block_id = block_id;
-    frame[page_id].dirty = false;
-    frame[page_id].pin = false;
-    frame[page_id].ref = true;
-    frame[page_id].empty = false;
-    nameID[make_pair(filename, block_id)] = page_id;
+/*
+ɾļͬһһɾĳļʱȸύɾδύʱָԸĻ
+ǰɾ¼
+*/
+bool BufferManager::removeFile(const string &filename) {
+    setEmpty(filename);
+    if (log == nullptr || current_txn == 0) return remove(filename.data()) == 0;
 
-    return block_id;
+    bool backup;
+    {
+        Lock lock(latch);
+        auto &backups = txn_backups[current_txn];
+        backup = (backups.end() == std::find(backups.begin(), backups.end(), filename));
+        if (backup) backups.push_back(filename);
+    }
+    log->flush(log->logDrop(current_txn, filename, backup));
+    if (backup) return moveFile(filename, BACKUP_FILE_PATH(filename));
+    return remove(filename.data()) == 0;
 }
 
-//ĳļصҳ
-void BufferManager::setEmpty(const string &filename) {
+//ԭļĻҳֱӶ뱣֤ļѰȫݲˢ
+void BufferManager::replaceFile(const string &filename, const string &new_filename) {
+    setEmpty(filename);
+    if (log != nullptr && current_txn != 0) {
+        bool backup;
+        {
+            Lock lock(latch);
+            auto &backups = txn_backups[current_txn];
+            backup = (backups.end() == std::find(backups.begin(), backups.end(), filename));
+            if (backup) backups.push_back(filename);
+        }
+        log->flush(log->logReplace(current_txn, filename, new_filename, backup));
+        if (backup) moveFile(filename, BACKUP_FILE_PATH(filename));
+    }
+    if (!moveFile(new_filename, filename)) throw MiniSQLException("Fail to replace file!");
+}
+
+int BufferManager::beginTransaction() {
+    if (log == nullptr) return 0;
+    current_txn = log->begin();
+    return current_txn;
+}
+
+/*
+ύԼڸµҳ;ڻʱǹҳд־дύ¼
+Щҳдǰ־̵ύ¼ΪֹдǰҲЩ¼־̺ɾļ
+*/
+void BufferManager::commitTransaction() {
+    int txn = current_txn;
+    current_txn = 0;
+    if (log == nullptr || txn == 0) return;
+
+    long long lsn;
+    vector<string> backups;
+    {
+        Lock lock(latch);
+        vector<int> pages;
+        auto it = txn_pages.find(txn);
+        if (txn_pages.end() != it) {
+            pages.swap(it->second);
+            txn_pages.erase(it);
+        }
+        vector<int> logged;
+        long long start = log->getLSN();
+        for (int page_id : pages) {
+            Page &page = frame[page_id];
+            if (page.txn != txn) continue;
+            log->logPage(txn, files[page.file_id].filename, page.block_id, page.buffer);
+            page.txn = 0;
+            logged.push_back(page_id);
+        }
+        lsn = log->logCommit(txn);
+        for (int page_id : logged) {
+            frame[page_id].lsn = lsn;
+            if (frame[page_id].rec_lsn == 0) frame[page_id].rec_lsn = start;
+        }
+
+        auto backup = txn_backups.find(txn);
+        if (txn_backups.end() != backup) {
+            backups.swap(backup->second);
+            txn_backups.erase(backup);
+        }
+    }
+    log->flush(lsn);
+    for (const auto &filename : backups) remove(BACKUP_FILE_PATH(filename).data());
+}
+
+//дҳٰѴ򿪵ļˢ
+void BufferManager::flushAll() {
+    Lock lock(latch);
+    loaded.wait(lock, [this] { return writing_count == 0; });
     for (int i = 0; i < page_num; i++) {
-        if (frame[i].filename == filename) {
-            auto it = nameID.find(make_pair(filename, frame[i].block_id));
-            nameID.erase(it);
-            frame[i] = Page();
+        if (frame[i].dirty && !frame[i].empty) {
+            writeBackToDisk(i, frame[i].file_id, frame[i].block_id);
+            frame[i].dirty = false;
         }
     }
+    for (const auto &file : files) {
+        if (file.used && file.fd != INVALID_FILE_HANDLE && !syncHandle(file.fd)) throw MiniSQLException("Fail to sync file!");
+    }
 }
 
-//̶/̶
-void BufferManager::setPagePin(int page_id, bool pin) {
-    frame[page_id].pin = pin;
+//ύڽе񣩡δסҳں̨д
+bool BufferManager::canWriteBack(int page_id) const {
+    const Page &page = frame[page_id];
+    return page.dirty && !page.empty && !page.loading && !page.writing && page.pin_count == 0 && page.txn == 0;
 }
 
-//ʱ滻һ/滻ҳ,page_id
-int BufferManager::getEmptyPage() {
+/*
+̨дһҳlatchڸݡǣſlatchд־д̡
+дڼҳɻȡҳ޸ճУ޸Ļ±Ϊҳ
+дʱڼûµύҳύ޸Ķڴ
+*/
+void BufferManager::writeBackCopy(int page_id, Lock &lock) {
+    Page &page = frame[page_id];
+    FileHandle fd = openFile(page.file_id);
+    vector<char> copy(page.buffer, page.buffer + PAGESIZE);
+    long long page_lsn = page.lsn;
+    long long offset = (long long)PAGESIZE * page.block_id;
+    page.dirty = false;
+    page.writing = true;
+    writing_count++;
+    lock.unlock();
+
+    bool ok = true;
+    try {
+        if (log != nullptr) log->flush(page_lsn);
+    }
+    catch (MiniSQLException &) { ok = false; }
+    ok = ok && writeAt(fd, copy.data(), PAGESIZE, offset);
+
+    lock.lock();
+    frame[page_id].writing = false;
+    writing_count--;
+    if (!ok) frame[page_id].dirty = true;
+    else if (frame[page_id].lsn == page_lsn) frame[page_id].rec_lsn = 0;
+    loaded.notify_all();
+    if (!ok) throw MiniSQLException("Fail to write file!");
+}
+
+void BufferManager::startWriter(int pages_per_second) {
+    if (pages_per_second <= 0 || writer.joinable()) return;
+    writer = std::thread(&BufferManager::writerLoop, this, pages_per_second);
+}
+
+//ÿִ滻ԸġҪҳдbudgetʱͲͬд
+void BufferManager::writerLoop(int pages_per_second) {
+    int budget = std::max(1, pages_per_second * WRITER_INTERVAL / 1000);
+    vector<int> pages;
+    Lock lock(latch);
+    while (!stopping) {
+        writer_wake.wait_for(lock, std::chrono::milliseconds(WRITER_INTERVAL), [this] { return stopping; });
+        if (stopping) break;
+        pages.clear();
+        replacer->candidates(budget * 4, pages);
+        int written = 0;
+        for (int page_id : pages) {
+            if (written >= budget || stopping) break;
+            if (page_id >= page_num || !canWriteBack(page_id)) continue;
+            try { writeBackCopy(page_id, lock); }
+            catch (MiniSQLException &) {}//дʧܵҳҳʱд
+            written++;
+        }
+    }
+}
+
+//дؿдصҳÿдbudgetҳЪһ
+void BufferManager::flushCommitted(int pages_per_second) {
+    int budget = (pages_per_second > 0) ? std::max(1, pages_per_second * WRITER_INTERVAL / 1000) : 0;
+    Lock lock(latch);
+    int written = 0;
     for (int i = 0; i < page_num; i++) {
-        if (frame[i].empty == true) return i;
-    }
-    //ûпյģʱ滻
-    while (1) {
-        if (frame[replace_position].ref == true)
-            frame[replace_position].ref = false;
-        else if (frame[replace_position].pin == false) {//ûס
-            string filename = frame[replace_position].filename;
-            int block_id = frame[replace_position].block_id;
-            if (frame[replace_position].dirty == true) {
-                //д
-                writeBackToDisk(replace_position, filename, block_id);
-                //ոҳݣ³ʼ
-                frame[replace_position] = Page();
-            }
-            auto it = nameID.find(make_pair(filename, block_id));
-            nameID.erase(it);
-            break;
-        }
-        replace_position = (replace_position + 1) % page_num;
-    }
-    return replace_position;
-}
-//ļеĿصڴһҳ
-void BufferManager::loadBlockToPage(int page_id, const string &filename, int block_id) {
-    FILE* fp;
-    fopen_s(&fp, filename.c_str(), "rb");
-    if (fp == nullptr) throw MiniSQLException("Fail to open file!"); //ļʧ
-
-    //λͶȡ
-    fseek(fp, sizeof(char) * PAGESIZE * block_id, SEEK_SET);
-    char* head = frame[page_id].buffer;
-    fread(head, sizeof(char), PAGESIZE, fp);
-    fclose(fp);
-    frame[page_id].filename = filename;
+        if (!canWriteBack(i)) continue;
+        writeBackCopy(i, lock);
+        if (budget > 0 && ++written % budget == 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_INTERVAL));
+            lock.lock();
+        }
+    }
+}
+
+long long BufferManager::getRecoveryLSN() {
+    Lock lock(latch);
+    long long lsn = LLONG_MAX;
+    for (int i = 0; i < page_num; i++) {
+        if (!frame[i].empty && frame[i].rec_lsn != 0 && frame[i].rec_lsn < lsn) lsn = frame[i].rec_lsn;
+    }
+    return lsn;
+}
+
+//ļˢ̣latchڵȴ
+void BufferManager::syncFiles() {
+    vector<string> filenames;
+    {
+        Lock lock(latch);
+        for (const auto &file : files) {
+            if (file.used) filenames.push_back(file.filename);
+        }
+    }
+    for (const auto &filename : filenames) {
+        if (!syncByName(filename)) throw MiniSQLException("Fail to sync file!");
+    }
+}
+
+//һҳû滻Իһҳ,page_id
+int BufferManager::getEmptyPage() {
+    if (!freePages.empty()) {
+        int page_id = freePages.back();
+        freePages.pop_back();
+        return page_id;
+    }
+    //ûпյģ滻ѡһҳ
+    int page_id = replacer->victim([this](int i) { return 0 == frame[i].pin_count && !frame[i].writing; });
+    if (-1 == page_id) throw MiniSQLException("No Free Page!");
+
+    if (frame[page_id].dirty == true) {
+        //д
+        writeBackToDisk(page_id, frame[page_id].file_id, frame[page_id].block_id);
+    }
+    pageTable.erase(frame[page_id].file_id, frame[page_id].block_id);
+    frame[page_id].file_id = -1;
+    frame[page_id].block_id = -1;
+    frame[page_id].dirty = false;
+    frame[page_id].empty = true;
+    frame[page_id].txn = 0;
+    frame[page_id].lsn = 0;
+    frame[page_id].rec_lsn = 0;
+    return page_id;
+}
+//һҳӳ䵽ļеĿ飬ҳɵ
+void BufferManager::mapPage(int page_id, int file_id, int block_id) {
+    frame[page_id].file_id = file_id;
     frame[page_id].block_id = block_id;
     frame[page_id].dirty = false;
-    frame[page_id].pin = false;
-    frame[page_id].ref = true;
+    frame[page_id].pin_count = 0;
     frame[page_id].empty = false;
-    nameID[make_pair(filename,block_id)] = page_id;
+    frame[page_id].txn = 0;
+    frame[page_id].lsn = 0;
+    frame[page_id].rec_lsn = 0;
+    frame[page_id].prefetched = false;
+    frame[page_id].failed = false;
+    pageTable.insert(file_id, block_id, page_id);
+    replacer->recordLoad(page_id);
+}
+
+void BufferManager::unmapPage(int page_id) {
+    pageTable.erase(frame[page_id].file_id, frame[page_id].block_id);
+    replacer->remove(page_id);
+    frame[page_id].file_id = -1;
+    frame[page_id].block_id = -1;
+    frame[page_id].dirty = false;
+    frame[page_id].empty = true;
+    frame[page_id].txn = 0;
+    frame[page_id].lsn = 0;
+    frame[page_id].rec_lsn = 0;
+    frame[page_id].failed = false;
+    freePages.push_back(page_id);
 }
 
-//ҳдش
-void BufferManager::writeBackToDisk(int page_id, const string &filename, int block_id) {
-    FILE* fp;
-    fopen_s(&fp, filename.c_str(), "rb+");
-    if (fp == nullptr) throw MiniSQLException("Fail to open file!"); //ļʧ
+//һſ߳̽ӳ䣬֮ȡһ¶
+void BufferManager::releaseFailed(int page_id) {
+    if (--frame[page_id].pin_count == 0) unmapPage(page_id);
+}
 
-    //λд
-    fseek(fp, sizeof(char) * PAGESIZE * block_id, SEEK_SET);
+/*
+ҳдش
+δύĹҳȰѴϵԭݺݶǽ־ָʱ
+дǰ־̵ҳݵļ¼Ϊֹ
+*/
+void BufferManager::writeBackToDisk(int page_id, int file_id, int block_id) {
+    FileHandle fd = openFile(file_id);
     char* head = frame[page_id].buffer;
-    fwrite(head, sizeof(char), PAGESIZE, fp);
-    fclose(fp);
+    long long offset = (long long)PAGESIZE * block_id;
+
+    if (log != nullptr) {
+        Page &page = frame[page_id];
+        if (page.txn != 0) {
+            vector<char> before(PAGESIZE);
+            size_t read = readAt(fd, before.data(), PAGESIZE, offset);
+            memset(before.data() + read, 0, PAGESIZE - read);
+            log->logPage(page.txn, files[file_id].filename, block_id, before.data(), true);
+            page.lsn = log->logPage(page.txn, files[file_id].filename, block_id, head);
+            page.txn = 0;
+        }
+        log->flush(page.lsn);
+    }
+
+    //ƫд
+    if (!writeAt(fd, head, PAGESIZE, offset)) throw MiniSQLException("Fail to write file!");
+    frame[page_id].rec_lsn = 0;
+}
+
+PageGuard::PageGuard(BufferManager *buffer, int page_id) : buffer(buffer), page_id(page_id), file_id(-1) {
+    head = buffer->frame[page_id].buffer;
+}
+
+PageGuard::PageGuard(BufferManager *buffer, int file_id, char *head) : buffer(buffer), page_id(MAPPED_PAGE_ID), head(head), file_id(file_id) {}
+
+PageGuard::PageGuard(PageGuard &&rhs) : buffer(rhs.buffer), page_id(rhs.page_id), head(rhs.head), file_id(rhs.file_id) {
+    rhs.buffer = nullptr;
+    rhs.page_id = -1;
+    rhs.head = nullptr;
+    rhs.file_id = -1;
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&rhs) {
+    if (this != &rhs) {
+        release();
+        buffer = rhs.buffer;
+        page_id = rhs.page_id;
+        head = rhs.head;
+        file_id = rhs.file_id;
+        rhs.buffer = nullptr;
+        rhs.page_id = -1;
+        rhs.head = nullptr;
+        rhs.file_id = -1;
+    }
+    return *this;
+}
+
+void PageGuard::markDirty() {
+    if (MAPPED_PAGE_ID == page_id) throw MiniSQLException("Page Is Read Only!");
+    if (page_id != -1) buffer->setDirty(page_id);
+}
+
+void PageGuard::release() {
+    if (page_id == -1) return;
+    if (MAPPED_PAGE_ID == page_id) buffer->unpinMapped(file_id);
+    else buffer->unpinPage(page_id);
+    buffer = nullptr;
+    page_id = -1;
+    head = nullptr;
+    file_id = -1;
+}
+
+//λֽ"2G""512M""64K""4096"
+size_t parseByteSize(const string &str) {
+    size_t pos = 0;
+    unsigned long long size;
+    try { size = std::stoull(str, &pos); }
+    catch (...) { throw MiniSQLException("Illegal Size!"); }
+
+    string unit = str.substr(pos);
+    if (unit == "" || unit == "B" || unit == "b") return (size_t)size;
+    if (unit == "K" || unit == "k" || unit == "KB" || unit == "kb") return (size_t)(size << 10);
+    if (unit == "M" || unit == "m" || unit == "MB" || unit == "mb") return (size_t)(size << 20);
+    if (unit == "G" || unit == "g" || unit == "GB" || unit == "gb") return (size_t)(size << 30);
+    throw MiniSQLException("Illegal Size!");
+}
+
+//дļˢ
+bool syncFile(FILE *fp) {
+    if (fflush(fp) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+//һļԭӵ滻һ
+bool moveFile(const string &from, const string &to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
 }
 
 void BufferManager_test() {
-    BufferManager BM = BufferManager();
+    BufferManager BM;
     try {
-        char *head = BM.getBlockContent("../test.txt", 2);
-        //int newBlock = BM.allocNewBlock("../test.txt");
-        //head = BM.getBlockContent("../test.txt", newBlock);
-        std::cout << head;
+        int file = BM.registerFile("../test.txt");
+        PageGuard page = BM.fetchPage(file, 2);
+        //int newBlock = BM.allocNewBlock(file);
+        //page = BM.fetchPage(file, newBlock);
+        std::cout << page.data();
         char mod[] = "abc";
-        BM.setBlockContent("../test.txt", 2, 0, mod, sizeof(mod));
+        PageGuard modPage = BM.fetchPage(file, 2, PageIntent::WRITE);
+        memcpy_s(modPage.data(), PAGESIZE, mod, sizeof(mod));
     } catch (MiniSQLException &e){
         std::cout << e.getMessage();
     }
-}
\ No newline at end of file
+}
@@ -1,62 +1,280 @@
 #pragma once
 
+#include "MiniSQLReplacer.h"
+#include "MiniSQLThreadPool.h"
 #include <string>
 #include <map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstdio>
 using std::string;
 using std::map;
 using std::pair;
+using std::vector;
 
 #define PAGESIZE 4096   //һҳ4KB
-#define MAXPAGENUM 100 //100ҳ
+#define HUGEPAGESIZE (2 << 20)   //ҳ2MBҳ鰴
+#define DEFAULT_POOL_SIZE (64 << 20)   //Ĭϻ64MB
+#define MINPAGENUM 16 //16ҳ
+#define WRITER_INTERVAL 100   //̨дÿּ룩ַٰ
+#define DEFAULT_WRITER_RATE 2048   //̨дĬÿдصҳ
+#define DEFAULT_CHECKPOINT_RATE 8192   //Ĭÿдصҳ
+#define DEFAULT_CHECKPOINT_INTERVAL 60   //Ĭÿ60һμ
+#define PREFETCH_THREADS 4   //Ԥ߳ͬʱеĶ
+#define DEFAULT_CHECKPOINT_LOG_SIZE (256 << 20)   //־256MBʱҲǰ
+
+#ifdef _WIN32
+typedef void* FileHandle;//ļ(HANDLE)
+#else
+typedef int FileHandle;//ļ
+#endif
+
+class BufferManager;
+class LogManager;
+
+//̨дغͼãҳΪ0ʾ٣Ϊ0ʾ
+struct FlushConfig {
+    int writer_rate = DEFAULT_WRITER_RATE;//̨дÿдصҳ0ʾ̨д
+    int checkpoint_rate = DEFAULT_CHECKPOINT_RATE;//ÿдصҳ
+    int checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;//룩
+    long long checkpoint_log_size = DEFAULT_CHECKPOINT_LOG_SIZE;//־ϴμ˴˴Сʱǰ
+};
+
+//ȡҳ;дζҳᱻ޸ģȡʱΪҳ
+//ֻʾȡú󲻻޸ģӳʱֱָļӳ
+enum class PageIntent {
+    READ = 0, WRITE, READ_ONLY
+};
+
+//ļķʷʽӳʱΪϵͳʾ
+enum class AccessPattern {
+    SEQUENTIAL = 0, RANDOM
+};
+
+#define MAPPED_PAGE_ID (-2)   //ֱָļӳ䡢ڻеҳ
+
+/*                                          */
+/*                                          */
+/*          ҳڼҳס      */
+/*                                          */
+/*                                          */
+
+//ȡʱסҳü+1ʱֻƶɸ
+class PageGuard {
+public:
+    PageGuard() : buffer(nullptr), page_id(-1), head(nullptr), file_id(-1) {}
+    PageGuard(PageGuard &&rhs);
+    PageGuard &operator=(PageGuard &&rhs);
+    PageGuard(const PageGuard &) = delete;
+    PageGuard &operator=(const PageGuard &) = delete;
+    ~PageGuard() { release(); }
+
+    char *data() const { return head; }
+    int getPageID() const { return page_id; }
+    bool valid() const { return page_id != -1; }
+
+    void markDirty();//ԶʽȡúҪ޸ʱãֻʽȡõĲ޸
+    void release();//ǰס
+private:
+    PageGuard(BufferManager *buffer, int page_id);//ҳBufferManagerס
+    PageGuard(BufferManager *buffer, int file_id, char *head);//ļӳеһҳӳѶס
+    friend class BufferManager;
+
+    BufferManager *buffer;
+    int page_id;
+    char *head;
+    int file_id;//ӳеҳļ
+};
 
 class BufferManager {
 private:
     struct Page {
         Page();
-        char buffer[PAGESIZE];//
-        string filename;//ӳļ
+        char *buffer;//ݣָҳеһҳ
+        int file_id;//ӳļ
         int block_id;//ӳ
         bool dirty;//޸ı
-        bool pin;//
-        bool ref;//ʹñǣʱ滻
+        int pin_count;//ס0ʱɻ
         bool empty;//ձ
+        bool loading;//ڴӴ̶룬ǰ߳ȴ
+        int txn;//޸˸ҳδύ0ʾûУ
+        long long lsn;//ҳݵ־¼ĩβдǰ־̵
+        long long rec_lsn;//ύδдص޸־λã0ʾûУ㲻˺־
+        bool writing;//̨дظҳĸڼ䲻ɻ
+        bool prefetched;//Ԥװûбȡ
+        bool failed;//̳ס̶߳ſŻؿҳ
+    };
+
+    //(ļ,)->ҳ ĿѰַϣ̽⣩
+    class PageTable {
+    public:
+        PageTable(int page_num);
+        int find(int file_id, int block_id) const;
+        void insert(int file_id, int block_id, int page_id);
+        void erase(int file_id, int block_id);
+    private:
+        static long long makeKey(int file_id, int block_id) { return ((long long)file_id << 32) | (unsigned int)block_id; }
+        int slotOf(long long key) const;
+
+        vector<long long> keys;//-1ʾղ
+        vector<int> pages;
+        int mask;//-1Ϊ2ݣ
+    };
+
+    //ѵǼǵļ
+    struct Mapping {
+        char *addr;
+        long long size;
+    };
+    struct File {
+        string filename;//ļ
+        FileHandle fd;//δʱΪЧֵ
+        bool used;//ǷѵǼ
+        AccessPattern pattern;
+        Mapping map;//ֻӳ䣨ûʱaddrΪգ
+        vector<Mapping> retired;//ļ䳤µľӳ䣬ûҳָʱŽ
+        int map_pins;//ָӳҳ
     };
 
     //̬ҳ
     int page_num;//ҳ
-    Page* frame;//׵ַָ
-    map<pair<string,int>, int> nameID;
-    int replace_position;//ʱָ루ʱ滻
+    char *arena;//ҳ飨ҳ룬ҳϢֿţ
+    size_t arena_size;
+    Page* frame;//ҳϢ׵ַָ
+    PageTable pageTable;
+    vector<int> freePages;//ҳ
+    ReplacePolicy policy;
+    Replacer *replacer;//滻
+    void initPool(size_t pool_size);
+    void releasePool();
+
+    //ҳϢҳ滻ԺļǼǱʱУдػҳʱ
+    std::mutex latch;
+    std::condition_variable loaded;//ĳҳ
+    typedef std::unique_lock<std::mutex> Lock;
+
+    ///δм
+    long long hit_count;
+    long long miss_count;
+
+    //ļǼǱ±꼴ļ
+    vector<File> files;
+    map<string, int> fileID;
+    FileHandle openFile(int file_id);
+    void closeFile(int file_id);
+
+    //ӳֻʽȡҳڻʱֱָļӳ䣬ʡȥһθ
+    bool mapped_reads;
+    //ȡӳеһ飬ļ䳤ʱӳ䣻ļĩβӳʧܷؿ
+    char *mapBlock(int file_id, int block_id);
+    void unpinMapped(int file_id);
+
+    //һҳû滻Իһҳ,page_id
+    int getEmptyPage();
+
+    //һҳӳ䵽ļеĿ飬Ǽǵҳ滻
+    void mapPage(int page_id, int file_id, int block_id);
+    //ҳӳ䣬Żؿҳ
+    void unmapPage(int page_id);
+    //ſʧܵҳϵһζס
+    void releaseFailed(int page_id);
+
+    //ҳдش̣ȰԤд־Ҫд־
+    void writeBackToDisk(int page_id, int file_id, int block_id);
+
+    //Ԥд־Ϊʱ־
+    LogManager *log;
+    //Ĺҳļ
+    map<int, vector<int>> txn_pages;
+    map<int, vector<string>> txn_backups;
+    void tagPage(int page_id);
+
+    //̨д滻ҳύҳǰд
+    std::thread writer;
+    std::condition_variable writer_wake;
+    bool stopping;
+    int writing_count;//ں̨дصҳ
+    void writerLoop(int pages_per_second);
+    bool canWriteBack(int page_id) const;
+    //latchڸҳݣſlatchд
+    void writeBackCopy(int page_id, Lock &lock);
+
+    //Ԥ̳߳е̶̣߳ǰҳס
+    std::unique_ptr<ThreadPool> prefetcher;
+    int prefetch_count;//Ԥҳ
+    void loadPage(int page_id, FileHandle fd, long long offset);
+
+    //סlatchסͱҳPageGuard
+    void pinPage(int page_id, PageIntent intent);
+    void unpinPage(int page_id);
+    void setDirty(int page_id);
+    friend class PageGuard;
 public:
-    BufferManager(int page_num = MAXPAGENUM);//캯(ʼҳ)
+    BufferManager(size_t pool_size = DEFAULT_POOL_SIZE, ReplacePolicy policy = ReplacePolicy::CLOCK, LogManager *log = nullptr);//캯(ֽʼҳ)
     ~BufferManager();//
 
-    //ȡļпӦڴҳ
-    int getPageID(const string &filename, int block_id);
+    //شСдҳµֽ·
+    void resize(size_t pool_size);
+    size_t getPoolSize() const { return (size_t)page_num * PAGESIZE; }
+
+    //ǼļļţѵǼֱӷأ
+    int registerFile(const string &filename, AccessPattern pattern = AccessPattern::SEQUENTIAL);
 
-    //ȡĳҳ
-    char* getBlockContent(const string &filename, int block_id);
-    char* getBlockContent(int page_id);
+    //ӳֻȡҳʱûеĿֱӶļӳ䣬дԾء
+    //еҳǱȴϵ£Ȳ黺أҳдغӳмɼ
+    void enableMappedReads();
 
-    //޸ĳҳ
-    void setBlockContent(const string &filename, int block_id, int offset, char* data, size_t length);
-    void setBlockContent(int page_id, int offset, char* data, size_t length);
+    //ȡĳڵҳסǰҳᱻɶ߳ͬʱ
+    PageGuard fetchPage(int file_id, int block_id, PageIntent intent = PageIntent::READ);
 
-    //ļ¿һ飬ضӦҳ
-    int allocNewBlock(const string &filename);
+    //ԤЩǰ뻺أȶͷءڻеĿļĩβĿ
+    //ķ֮һҳԤʱԤ֮ȡЩҳʱû꣬
+    void prefetch(int file_id, const vector<int> &block_ids);
+    //Ԥblock_idcount
+    void prefetch(int file_id, int block_id, int count);
 
-    //ĳļصҳ
+    //ļ¿һ飬ضӦĿ
+    int allocNewBlock(int file_id);
+    //ļеĿ¿ݻڻеĿ飩
+    int getBlockCount(int file_id);
+
+    //ĳļصҳرעļ
     void setEmpty(const string &filename);
-    
-    //̶/̶
-    void setPagePin(int page_id, bool pin);
+    //½ļǷ񴴽ɹ
+    bool createFile(const string &filename);
+    //ĳļҳɾǷɾɹ
+    bool removeFile(const string &filename);
+    //ĳļҳһļԭӵ滻
+    void replaceFile(const string &filename, const string &new_filename);
 
-    //ʱ滻һ/滻ҳ,page_id
-    int getEmptyPage();
+    //񣺿ʼǰ߳дʽסҳҳڸ£ļɾҲǽ־
+    //ύʱЩҳݺύ¼д־̡û־ʱκ
+    int beginTransaction();
+    void commitTransaction();
+
+    //дҳˢ̣㣩
+    void flushAll();
+
+    //̨дÿдpages_per_secondҳ
+    void startWriter(int pages_per_second);
+    //ģ㣺Ƚедύδסҳÿpages_per_secondҳ0٣
+    void flushCommitted(int pages_per_second);
+    //ύδдص޸־λãûзLLONG_MAX
+    long long getRecoveryLSN();
+    //ѵǼǵļˢ
+    void syncFiles();
 
-    //ļеĿصڴһҳ
-    void loadBlockToPage(int page_id, const string &file_name, int block_id);
+    ///δд
+    long long getHitCount() { Lock lock(latch); return hit_count; }
+    long long getMissCount() { Lock lock(latch); return miss_count; }
+};
 
-    //ҳдش
-    void writeBackToDisk(int page_id, const string &file_name, int block_id);
-};
\ No newline at end of file
+//λֽ"2G""512M""64K""4096"
+size_t parseByteSize(const string &str);
+//дļˢ
+bool syncFile(FILE *fp);
+//һļԭӵ滻һ
+bool moveFile(const string &from, const string &to);
@@ -1,5 +1,69 @@
 #include "MiniSQLCatalogManager.h"
 #include <fstream>
+#include <sstream>
+
+//һűϢͷһУ֮ÿһ
+static bool readTable(std::istream &inf, string &tablename, Table &table) {
+    string line;
+    while (std::getline(inf, line)) {
+        std::istringstream header(line);
+        int size;
+        if (!(header >> tablename >> table.record_length >> table.occupied_record_count >> size)) continue;
+        //ɵԪļûпвϢЧ¼ռõĲ㣨ֻƫ󣩣þɵĿղ
+        if (!(header >> table.live_record_count >> table.free_slot)) {
+            table.live_record_count = table.occupied_record_count;
+            table.free_slot = -1;
+        }
+        table.attrs.clear();
+        string attr_name;
+        Type attr_type;
+        bool attr_unique;
+        for (int i = 0; i < size; i++) {
+            inf >> attr_name >> attr_type >> attr_unique;
+            table.attrs.push_back({ attr_name, attr_type, attr_unique });
+        }
+        return true;
+    }
+    return false;
+}
+
+static void writeTable(std::ostream &outf, const string &tablename, const Table &table) {
+    outf << tablename << " " << table.record_length << " " << table.occupied_record_count << " " << table.attrs.size()
+        << " " << table.live_record_count << " " << table.free_slot << std::endl;
+    for (const auto &attr : table.attrs) {
+        outf << attr.name << " " << attr.type << " " << attr.unique << std::endl;
+    }
+}
+
+//һűϢ֮ÿһ
+static bool readIndexes(std::istream &inf, string &tablename, vector<Index> &indexes) {
+    int size;
+    if (!(inf >> tablename >> size)) return false;
+    indexes.clear();
+    string indexname;
+    int rank;
+    string keyname;
+    int key_size;
+    for (int i = 0; i < size; i++) {
+        set<string> keys;
+        inf >> indexname >> rank >> key_size;
+        for (int j = 0; j < key_size; j++) {
+            inf >> keyname;
+            keys.insert(keyname);
+        }
+        indexes.push_back({ indexname, rank, keys });
+    }
+    return true;
+}
+
+static void writeIndexes(std::ostream &outf, const string &tablename, const vector<Index> &indexes) {
+    outf << tablename << " " << indexes.size() << std::endl;
+    for (const auto &index : indexes) {
+        outf << index.name << " " << index.rank << " " << index.keys.size();
+        for (const auto &attr : index.keys) outf << " " << attr;
+        outf << std::endl;
+    }
+}
 
 CatalogManager::CatalogManager(const char *meta_table_file_name, const char *meta_index_file_name)
     : meta_table_file_name(meta_table_file_name), meta_index_file_name(meta_index_file_name)
@@ -17,21 +81,8 @@ CatalogManager::CatalogManager(const char *meta_table_file_name, const char *met
         if (!inf.is_open()) throw MiniSQLException("Cannot Read Meta Table File!");
 
         string tablename;
-        size_t record_length;
-        int occupied_record_count;
-        int size;
-        while (!inf.eof()) {
-            inf >> tablename >> record_length >> occupied_record_count >> size;
-            vector<Attr> attrs;
-            string attr_name;
-            Type attr_type;
-            bool attr_unique;
-            for (int i = 0; i < size; i++) {
-                inf >> attr_name >> attr_type >> attr_unique;
-                attrs.push_back({ attr_name, attr_type, attr_unique });
-            }
-            table.insert(make_pair(tablename, Table{ attrs, record_length, occupied_record_count }));
-        }
+        Table table_def;
+        while (readTable(inf, tablename, table_def)) table.insert(make_pair(tablename, table_def));
         inf.close();
     }
     //indexϢ
@@ -46,69 +97,114 @@ CatalogManager::CatalogManager(const char *meta_table_file_name, const char *met
         if (!inf.is_open()) throw MiniSQLException("Cannot Read Meta Index File!");
 
         string tablename;
-        int size;
-        while (!inf.eof()) {
-            inf >> tablename >> size;
-            vector<Index> indexes;
-            string indexname;
-            int rank;
-            string keyname;
-            int key_size;
-            set<string> keys;
-            for (int i = 0; i < size; i++) {
-                inf >> indexname >> rank >> key_size;
-                for (int j = 0; j < key_size; j++) {
-                    inf >> keyname;
-                    keys.insert(keyname);
-                }
-                indexes.push_back({ indexname, rank, keys });
-            }
-            index.insert(make_pair(tablename, indexes));
-        }
-
+        vector<Index> indexes;
+        while (readIndexes(inf, tablename, indexes)) index.insert(make_pair(tablename, indexes));
         inf.close();
     }
+    committed_table = table;
+    committed_index = index;
 }
 
 CatalogManager::~CatalogManager() {
-    //дtableϢ
-    std::ofstream outf(meta_table_file_name);
-    if (!outf.is_open()) {
-        std::cout << "Cannot Open Meta Table File to Write in!" << std::endl;
-    } else {
-        for (const auto &tab : table) {
-            const Table &table_def = tab.second;
-            const auto &attr_def = table_def.attrs;
-            outf << tab.first << " " << table_def.record_length << " " << table_def.occupied_record_count << " " << attr_def.size() << std::endl;
-            for (const auto &attr : attr_def) {
-                outf << attr.name << " " << attr.type << " " << attr.unique << std::endl;
-            }
-        }
-        outf.close();
+    try { save(); }
+    catch (MiniSQLException &e) {
+        std::cout << e.getMessage() << std::endl;
     }
+}
 
+//дʱļˢ̣滻ԭļ;дһԪ
+void CatalogManager::save() const {
+    auto write = [](const string &filename, const string &content, const char *message) {
+        string tmp_filename = filename + ".tmp";
+        FILE *fp;
+        if (fopen_s(&fp, tmp_filename.data(), "w") != 0) throw MiniSQLException(message);
+        bool ok = fwrite(content.data(), 1, content.size(), fp) == content.size();
+        ok = syncFile(fp) && ok;
+        fclose(fp);
+        if (!ok || !moveFile(tmp_filename, filename)) throw MiniSQLException(message);
+    };
+
+    std::ostringstream table_out, index_out;
+    {
+        std::lock_guard<std::mutex> lock(committed_lock);
+        for (const auto &tab : committed_table) writeTable(table_out, tab.first, tab.second);
+        for (const auto &ind : committed_index) writeIndexes(index_out, ind.first, ind.second);
+    }
+    //дtableϢ
+    write(meta_table_file_name, table_out.str(), "Cannot Open Meta Table File to Write in!");
     //дindexϢ
-    outf = std::ofstream(meta_index_file_name);
-    if (!outf.is_open()) {
-        std::cout << "Cannot Open Meta Index File to Write in!" << std::endl;
-    } else {
-        for (const auto &ind : index) {
-            const vector<Index> &indexes = ind.second;
-            outf << ind.first << " " << indexes.size() << std::endl;
-            for (const auto &index : indexes) {
-                outf << index.name << " " << index.rank << " " << index.keys.size();
-                for (const auto &attr : index.keys) outf << " " << attr;
-                outf << std::endl;
-            }
-        }
-        outf.close();
+    write(meta_index_file_name, index_out.str(), "Cannot Open Meta Index File to Write in!");
+}
+
+//߳иñд
+void CatalogManager::commitTable(const string &tablename) {
+    std::lock_guard<std::mutex> lock(committed_lock);
+    auto t = table.find(tablename);
+    if (table.end() == t) committed_table.erase(tablename);
+    else committed_table[tablename] = t->second;
+    auto ind = index.find(tablename);
+    if (index.end() == ind) committed_index.erase(tablename);
+    else committed_index[tablename] = ind->second;
+}
+
+string CatalogManager::dumpTable(const string &tablename) const {
+    auto t = table.find(tablename);
+    if (table.end() == t) return "";
+    std::ostringstream out;
+    writeTable(out, tablename, t->second);
+    auto ind = index.find(tablename);
+    writeIndexes(out, tablename, (index.end() == ind) ? vector<Index>() : ind->second);
+    return out.str();
+}
+
+void CatalogManager::restoreTable(const string &tablename, const string &text) {
+    table.erase(tablename);
+    index.erase(tablename);
+    if (!text.empty()) {
+        std::istringstream in(text);
+        string name;
+        Table table_def;
+        vector<Index> indexes;
+        if (!readTable(in, name, table_def) || !readIndexes(in, name, indexes)) throw MiniSQLException("Broken Catalog Record!");
+        table[tablename] = table_def;
+        index[tablename] = indexes;
     }
+    commitTable(tablename);
+}
+
+void CatalogManager::increaseRecordCount(const string &tablename, int count) {
+    auto t = table.find(tablename);
+    if (table.end() == t) throw MiniSQLException("Table Doesn't Exist!");
+    t->second.occupied_record_count += count;
+    t->second.live_record_count += count;
+}
+
+void CatalogManager::reuseFreeSlot(const string &tablename, int next_free_slot, int count) {
+    auto t = table.find(tablename);
+    if (table.end() == t) throw MiniSQLException("Table Doesn't Exist!");
+    t->second.live_record_count += count;
+    t->second.free_slot = next_free_slot;
+}
+
+void CatalogManager::releaseSlot(const string &tablename, int slot) {
+    auto t = table.find(tablename);
+    if (table.end() == t) throw MiniSQLException("Table Doesn't Exist!");
+    t->second.live_record_count--;
+    if (slot != -1) t->second.free_slot = slot;
+}
+
+void CatalogManager::setRecordCount(const string &tablename, int occupied_record_count, int live_record_count) {
+    auto t = table.find(tablename);
+    if (table.end() == t) throw MiniSQLException("Table Doesn't Exist!");
+    t->second.occupied_record_count = occupied_record_count;
+    t->second.live_record_count = live_record_count;
 }
 
-void CatalogManager::increaseRecordCount(const string &tablename) {
+void CatalogManager::compactTableInfo(const string &tablename) {
     auto t = table.find(tablename);
     if (table.end() == t) throw MiniSQLException("Table Doesn't Exist!");
-    table[tablename].occupied_record_count++;
+    t->second.occupied_record_count = t->second.live_record_count;
+    t->second.free_slot = -1;
 }
 
 const Table &CatalogManager::getTableInfo(const string &tablename) const {
@@ -122,7 +218,7 @@ void CatalogManager::addTableInfo(const string &tablename, const vector<Attr> &a
 
     size_t length = 1;
     for (auto attr : attrs) length += attr.type.size;
-    table[tablename] = { attrs, length, 0 };
+    table[tablename] = { attrs, length, 0, 0, -1 };
     index[tablename];
 }
 
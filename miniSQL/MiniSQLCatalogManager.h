@@ -5,6 +5,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <mutex>
 using std::vector;
 using std::string;
 using std::map;
@@ -18,7 +19,9 @@ struct Attr {
 struct Table {
     vector<Attr> attrs;
     size_t record_length;
-    int occupied_record_count;
+    int occupied_record_count;//ļռõĲɾģ
+    int live_record_count;//Ч¼
+    int free_slot;//вͷ-1ʾû
 };
 using table_file = map<string, Table>;
 
@@ -35,7 +38,16 @@ public:
     CatalogManager(const char *meta_table_file_name, const char *meta_index_file_name);
     ~CatalogManager();
 
-    void increaseRecordCount(const string &tablename);
+    //ļĩβcount¼
+    void increaseRecordCount(const string &tablename, int count = 1);
+    //˿ϵcountۣnext_free_slotΪµͷ
+    void reuseFreeSlot(const string &tablename, int next_free_slot, int count = 1);
+    //ɾһ¼slotΪۺţ-1ʾò۲ܸã
+    void releaseSlot(const string &tablename, int slot);
+    //ʱѼ¼˻ԭֵ
+    void setRecordCount(const string &tablename, int occupied_record_count, int live_record_count);
+    //ļѽдЧ¼ǰ棬ûпв
+    void compactTableInfo(const string &tablename);
 
     const Table &getTableInfo(const string &tablename) const;
     void addTableInfo(const string &tablename, const vector<Attr> &attrs);
@@ -47,9 +59,22 @@ public:
     void deleteIndexInfo(const string &tablename, const string &indexname);
     void deleteIndexInfo(const string &tablename);
 
+    //űǰϢΪύϢ
+    void commitTable(const string &tablename);
+    //ύıϢϢдԪļͬʱУ㣩
+    void save() const;
+    //һűıϢϢʽͬԪļʱΪմ
+    string dumpTable(const string &tablename) const;
+    //dumpTableĽָһűϢմʾñɾ
+    void restoreTable(const string &tablename, const string &text);
+
 private:
     string meta_table_file_name;
     string meta_index_file_name;
     table_file table;
     index_file index;
+    //ύĸе޸Ĳᱻ
+    mutable std::mutex committed_lock;
+    table_file committed_table;
+    index_file committed_index;
 };
\ No newline at end of file
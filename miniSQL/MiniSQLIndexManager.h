@@ -2,22 +2,27 @@
 
 #include "BPlusTree.h"
 #include "MiniSQLCatalogManager.h"
+#include "MiniSQLSorter.h"
+#include <mutex>
 using std::string;
 
 #define MAXCHARSIZE 255
+#define DEFAULT_FILL_FACTOR 0.9 //ʱװ
 #define INDEX_FILE_PATH(tablename, indexname) ("../" + (tablename) + "_" + (indexname) + ".index")
 
+//ַNĳȷֵ8/16/32/64/128/MAXCHARSIZE
+template<int N>
 struct FLString
 {
-    char content[MAXCHARSIZE];
+    char content[N];
     FLString() = default;
-    FLString(const FLString &rhs) { memcpy_s(content, MAXCHARSIZE, rhs.content, sizeof(rhs.content)); }
-    FLString(const Value& value) { memcpy_s(content, MAXCHARSIZE, value.translate<char*>(), value.type.size); }
-    FLString(const string &content) { memcpy_s(this->content, MAXCHARSIZE, content.data(), MAXCHARSIZE); }
-    FLString(const char *str) { strncpy_s(content, str, MAXCHARSIZE); }
+    FLString(const FLString &rhs) { memcpy_s(content, N, rhs.content, sizeof(rhs.content)); }
+    FLString(const Value& value) { memcpy_s(content, N, value.translate<char*>(), value.type.size); }
+    FLString(const string &content) { strncpy_s(this->content, content.c_str(), _TRUNCATE); }
+    FLString(const char *str) { strncpy_s(content, str, _TRUNCATE); }
 
     FLString& operator =(const FLString& rhs) {
-        memcpy_s(content, MAXCHARSIZE, rhs.content, sizeof(rhs.content));
+        memcpy_s(content, N, rhs.content, sizeof(rhs.content));
         return *this;
     }
 
@@ -34,64 +39,149 @@ struct FLString
     }
 };
 
+//Ӽ¼еȡ
+inline void readKey(int &key, const char *data) { memcpy_s(&key, sizeof(key), data, sizeof(key)); }
+inline void readKey(float &key, const char *data) { memcpy_s(&key, sizeof(key), data, sizeof(key)); }
+template<int N>
+inline void readKey(FLString<N> &key, const char *data) { key = FLString<N>(data); }
+
 class IndexManager {
 public:
-    IndexManager(BufferManager *buffer) : buffer(buffer) {}
+    IndexManager(BufferManager *buffer) : buffer(buffer), fill_factor(DEFAULT_FILL_FACTOR) {}
+
+    void setFillFactor(double fill) {
+        if (fill < 0.5 || fill > 1) throw MiniSQLException("Illegal Fill Factor!");
+        fill_factor = fill;
+    }
+
+    //ɼB+rankһҳrank+1ӽֵ
+    static int getRank(int key_size) {
+        return (PAGESIZE - NODE_HEADER_SIZE) / (sizeof(int) + sizeof(Position) + key_size) - 1;
+    }
+
+    //ַеļСгСһ
+    static int getCharKeySize(int column_size) {
+        for (int size = 8; size < MAXCHARSIZE; size <<= 1) {
+            if (size >= column_size) return size;
+        }
+        return MAXCHARSIZE;
+    }
+
+    //rankַļrankͬɵļһMAXCHARSIZE
+    static int getCharKeySizeByRank(int rank) {
+        for (int size = 8; size < MAXCHARSIZE; size <<= 1) {
+            if (getRank(size) == rank) return size;
+        }
+        return MAXCHARSIZE;
+    }
+
+    //ַrankѡFLString<N>Ը͵ֵf
+    template<typename Func>
+    static void dispatchCharKey(int rank, Func &&f) {
+        switch (getCharKeySizeByRank(rank)) {
+        case 8:    f(FLString<8>()); break;
+        case 16:    f(FLString<16>()); break;
+        case 32:    f(FLString<32>()); break;
+        case 64:    f(FLString<64>()); break;
+        case 128:    f(FLString<128>()); break;
+        default:    f(FLString<MAXCHARSIZE>()); break;
+        }
+    }
 
     template<typename KeyType>
     void createIndex(const string &tablename, const string &indexname, int size) {
-        string filename = INDEX_FILE_PATH(tablename, indexname);
-        BPlusTree<KeyType, Position> newTree(buffer, filename, size);
+        getTree<KeyType>(tablename, indexname, size);
+    }
+
+    //ź(,λ)մ
+    template<typename KeyType>
+    void bulkLoadIndex(const string &tablename, const string &indexname, int size, ExternalSorter<KeyType, Position> &sorter) {
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
+        sorter.finish();
+        try { tree.bulkLoad(sorter, sorter.size(), fill_factor); }
+        catch (BPlusTreeException &e) { throw MiniSQLException(e); }
     }
 
     void dropIndex(const string &tablename, const string &indexname) {
         string filename = INDEX_FILE_PATH(tablename, indexname);
-        buffer->setEmpty(filename);
-        remove(filename.data());
+        {
+            std::lock_guard<std::mutex> guard(trees_lock);
+            trees.erase(filename);
+        }
+        buffer->removeFile(filename);
     }
 
     template<typename KeyType>
     void insertIntoIndex(const string &tablename, const string &indexname, int size, const KeyType &key, const Position &pos) {
-        string filename = INDEX_FILE_PATH(tablename, indexname);
-        BPlusTree<KeyType, Position> tree(buffer, filename, size);
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
         try { tree.insertData(key, pos); }
         catch (BPlusTreeException &e) { throw MiniSQLException(e); }
     }
 
+    //һ(,λ)ź룬ڵļͬһҶϣʵҳ
+    template<typename KeyType>
+    void insertBatchIntoIndex(const string &tablename, const string &indexname, int size, std::vector<std::pair<KeyType, Position>> &entries) {
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
+        std::sort(entries.begin(), entries.end(), [](const std::pair<KeyType, Position> &lhs, const std::pair<KeyType, Position> &rhs) {
+            return lhs.first < rhs.first;
+        });
+        try {
+            for (const auto &entry : entries) tree.insertData(entry.first, entry.second);
+        }
+        catch (BPlusTreeException &e) { throw MiniSQLException(e); }
+    }
+
     template<typename KeyType>
     Position findOneFromIndex(const string &tablename, const string &indexname, int size, const KeyType &key) {
-        string filename = INDEX_FILE_PATH(tablename, indexname);
-        BPlusTree<KeyType, Position> tree(buffer, filename, size);
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
         auto iter = tree.getStart(key, true);
-        if ((*iter).first == key) {
-            return (*iter).second;
+        if (iter.valid() && iter.key() == key) {
+            return iter.value();
         }
         else return Position({ -1, 0 });
     }
 
     template<typename KeyType>
     void findRangeFromIndex(const string &tablename, const string &indexname, int size, const std::pair<Compare, KeyType> &startKey, const std::pair<Compare, KeyType> &endKey, const std::set<KeyType> &neKeys, std::vector<Position> &pos) {
-        string filename = INDEX_FILE_PATH(tablename, indexname);
-        BPlusTree<KeyType, Position> tree(buffer, filename, size);
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
         auto start = (startKey.first == Compare::EQ) ? tree.begin() : (startKey.first == Compare::GE) ? tree.getStart(startKey.second, true) : tree.getStart(startKey.second, false);
         auto end = (endKey.first == Compare::EQ) ? tree.end() : (endKey.first == Compare::LE) ? tree.getStart(endKey.second, false) : tree.getStart(endKey.second, true);
         auto neKey_ptr = neKeys.begin();
         auto neEnd = neKeys.end();
         while (start != end) {
-            if (neEnd != neKey_ptr && (*start).first == *neKey_ptr) {
+            KeyType key = start.key();
+            while (neEnd != neKey_ptr && *neKey_ptr < key) neKey_ptr++;
+            if (neEnd != neKey_ptr && key == *neKey_ptr) {
                 neKey_ptr++;
-            } else pos.push_back((*start).second);
+            } else pos.push_back(start.value());
             start.next();
         }
     }
 
     template<typename KeyType>
     void removeFromIndex(const string &tablename, const string &indexname, int size, const KeyType &key) {
-        string filename = INDEX_FILE_PATH(tablename, indexname);
-        BPlusTree<KeyType, Position> tree(buffer, filename, size);
+        BPlusTree<KeyType, Position> &tree = getTree<KeyType>(tablename, indexname, size);
         try { tree.removeData(key); }
         catch (BPlusTreeException &e) { throw MiniSQLException(e); }
     }
 private:
+    //ȡѴ򿪵δ򿪲Ǽ
+    template<typename KeyType>
+    BPlusTree<KeyType, Position> &getTree(const string &tablename, const string &indexname, int size) {
+        string filename = INDEX_FILE_PATH(tablename, indexname);
+        std::lock_guard<std::mutex> guard(trees_lock);
+        auto it = trees.find(filename);
+        if (trees.end() == it) {
+            std::unique_ptr<BPlusTreeInterface> tree(new BPlusTree<KeyType, Position>(buffer, filename, size));
+            it = trees.emplace(filename, std::move(tree)).first;
+        }
+        auto tree = dynamic_cast<BPlusTree<KeyType, Position>*>(it->second.get());
+        if (nullptr == tree) throw MiniSQLException("Index Type Mismatch!");
+        return *tree;
+    }
+
     BufferManager *buffer;
+    double fill_factor;
+    map<string, std::unique_ptr<BPlusTreeInterface>> trees;//Ѵ򿪵ļŵȳפڴ棬ɾʱע
+    std::mutex trees_lock;//ͬıͬʱ
 };
\ No newline at end of file
@@ -15,27 +15,35 @@ Type Interpreter::getType(const string &type_string) {
     return type;
 }
 
-void Interpreter::showResult(const Table &table, const ReturnTable &T) {
-    int i = 0;
-    int size[15];
-    cout.setf(ios::left);
-    for (const auto &attr : table.attrs) {
-        int datasize = (attr.type.btype == BaseType::CHAR) ? attr.type.size : 12;
-        size[i] = (datasize < attr.name.size()) ? attr.name.size() : datasize;
-        cout << setw(size[i]) << attr.name << " ";
-        i++;
-    }
-    cout << endl;
-    for (const auto &result : T) {
-        i = 0;
-        for (const auto &v : result.content) {
-            cout << setw(size[i]) << v << " ";
-            i++;
+//ȡȡһʱͷ
+int Interpreter::showResult(RecordCursor &cursor) {
+    const Table &table = cursor.getTable();
+    std::vector<int> size;
+    RowView row;
+    Position pos;
+    int count = 0;
+    out.setf(ios::left);
+    while (cursor.next(row, pos)) {
+        if (0 == count++) {
+            for (const auto &attr : table.attrs) {
+                int datasize = (attr.type.btype == BaseType::CHAR) ? attr.type.size : 12;
+                size.push_back((datasize < attr.name.size()) ? attr.name.size() : datasize);
+                out << setw(size.back()) << attr.name << " ";
+            }
+            out << endl;
+        }
+        for (size_t i = 0; i < row.size(); i++) {
+            out << setw(size[i]);
+            switch (row.type(i).btype) {
+            case BaseType::INT:    out << row.getInt(i); break;
+            case BaseType::FLOAT:    out << row.getFloat(i); break;
+            case BaseType::CHAR:    out << row.getChar(i); break;
+            }
+            out << " ";
         }
-        cout << endl;
+        out << endl;
     }
-    // "x row(s) affceted"
-    //ʱ
+    return count;
 }
 
 void Interpreter::parse_table_definition(const string &tablename, string &content, smatch &result) {
@@ -84,9 +92,7 @@ void Interpreter::parse_table_definition(const string &tablename, string &conten
     core->createTable(tablename, attr_def, primary_keys);
 }
 
-void Interpreter::parse_insert_value(const string &tablename, string &content, smatch &result) {
-    std::vector<Value> record;
-
+void Interpreter::parse_insert_value(string &content, smatch &result, Record &record) {
     istringstream split_by_comma(content);
     string attr_value;
     while (getline(split_by_comma, attr_value, ',')) {
@@ -108,7 +114,23 @@ void Interpreter::parse_insert_value(const string &tablename, string &content, s
         }
         else throw MiniSQLException("Illegal Inserted Value!");
     }
-    core->insertIntoTable(tablename, record);
+}
+
+//"(...), (...), ..."гɸԪڵݣԪܶʱܳݹ
+void Interpreter::split_insert_tuples(const string &tuples, std::vector<string> &contents) {
+    size_t p = 0;
+    while (true) {
+        p = tuples.find_first_not_of(' ', p);
+        if (p == string::npos || tuples[p] != '(') throw MiniSQLException("Syntax Error!");
+        size_t right = tuples.find(')', p);
+        if (right == string::npos) throw MiniSQLException("Syntax Error!");
+        contents.push_back(tuples.substr(p + 1, right - p - 1));
+
+        p = tuples.find_first_not_of(' ', right + 1);
+        if (p == string::npos) break;
+        if (tuples[p] != ',') throw MiniSQLException("Syntax Error!");
+        p++;
+    }
 }
 
 void Interpreter::parse_condition(string &content, smatch &result, Predicate &pred) {
@@ -159,13 +181,13 @@ void Interpreter::parse_input(const string &input) {
         content = result[2];
         //cout << "Match CREATE TABLE!" << endl << "[table name] " << tablename << endl << "[content] " << content << endl;
         parse_table_definition(tablename, content, result);
-        cout << "Create Table Succeeds." << endl;
+        out << "Create Table Succeeds." << endl;
     }
     else if (regex_match(input, result, drop_table_pattern)) {
         tablename = result[1];
         //cout << "Match DROP TABLE!" << endl << "[table name] " << tablename << endl;
         core->dropTable(tablename);
-        cout << "Drop Table Succeeds." << endl;
+        out << "Drop Table Succeeds." << endl;
     }
     else if (regex_match(input, result, create_index_pattern)) {
         indexname = result[1];
@@ -173,21 +195,25 @@ void Interpreter::parse_input(const string &input) {
         content = result[3];
         //cout << "Match CREATE INDEX!" << endl << "[table name] " << tablename << endl << "[index name] " << indexname << endl << "[content] " << content << endl;
         core->createIndex(tablename, indexname, { content });
-        cout << "Create Index Succeeds." << endl;
+        out << "Create Index Succeeds." << endl;
     }
     else if (regex_match(input, result, drop_index_pattern)) {
         indexname = result[1];
         tablename = result[2];
         //cout << "Match DROP INDEX!" << endl << "[table name] " << tablename << endl << "[index name] " << indexname << endl;
         core->dropIndex(tablename, indexname);
-        cout << "Drop Index Succeeds." << endl;
+        out << "Drop Index Succeeds." << endl;
     }
-    else if (regex_match(input, result, insert_pattern)) {
+    else if (regex_search(input, result, insert_pattern, regex_constants::match_continuous)) {
         tablename = result[1];
-        content = result[2];
+        std::vector<string> contents;
+        split_insert_tuples(result.suffix(), contents);
         //cout << "Match INSERT!" << endl << "[table name] " << tablename << endl << "[content] " << content << endl;
-        parse_insert_value(tablename, content, result);
-        cout << "1 Row Successfully Inserted." << endl;
+        std::vector<Record> records(contents.size());
+        for (size_t i = 0; i < contents.size(); i++) parse_insert_value(contents[i], result, records[i]);
+        int retCount = core->insertBatch(tablename, records);
+        if (1 == retCount) out << "1 Row Successfully Inserted." << endl;
+        else out << retCount << " Rows Successfully Inserted." << endl;
     }
     else if (regex_match(input, result, select_pattern)) {
         tablename = result[1];
@@ -196,13 +222,10 @@ void Interpreter::parse_input(const string &input) {
         //cout << "Match SELECT!" << endl << "[table name] " << tablename << endl << "[conditions] " << content << endl;
         Predicate pred;
         parse_condition(content, result, pred);
-        SQLResult result = core->selectFromTable(tablename, pred);
-        int retCount = result.ret.size();
-        if (0 == retCount) cout << "No Rows Satisfying the Condition(s)." << endl;
-        else {
-            cout << retCount << " Row(s) Fetched:" << endl;
-            showResult(result.table, result.ret);
-        }
+        RecordCursor cursor = core->selectFromTable(tablename, pred, parallelism);
+        int retCount = showResult(cursor);
+        if (0 == retCount) out << "No Rows Satisfying the Condition(s)." << endl;
+        else out << retCount << " Row(s) Fetched." << endl;
     }
     else if (regex_match(input, result, delete_pattern)) {
         tablename = result[1];
@@ -212,16 +235,48 @@ void Interpreter::parse_input(const string &input) {
         Predicate pred;
         parse_condition(content, result, pred);
         int retCount = core->deleteFromTable(tablename, pred);
-        cout << retCount << " Row(s) Affected." << endl;
+        out << retCount << " Row(s) Affected." << endl;
+    }
+    else if (regex_match(input, result, load_pattern)) {
+        string filename = result[1];
+        tablename = result[2];
+        bool binary = result.length(3) != 0;
+        bool defer_index = result.length(4) != 0;
+        int retCount = core->loadData(tablename, filename, binary, defer_index);
+        out << retCount << " Row(s) Loaded." << endl;
+    }
+    else if (regex_match(input, result, vacuum_pattern)) {
+        tablename = result[1];
+        long long reclaimed = core->vacuumTable(tablename);
+        out << "Table " << tablename << " Vacuumed, " << reclaimed << " Bytes Reclaimed." << endl;
     }
     else if (regex_match(input, result, execfile_pattern)) {
         string filename = result[1];
         //cout << "Match EXECFILE!" << endl << "[filename] " << result[1] << endl;
         std::ifstream inf(filename);
         if (!inf.is_open()) throw MiniSQLException("File Doesn't Exist!");
-        Interpreter interp(core, inf, out);
+        Interpreter interp(core, inf, out, parallelism);
         interp.start();
         inf.close();
+        parallelism = interp.parallelism;
+    }
+    else if (regex_match(input, result, buffer_pool_pattern)) {
+        size_t pool_size = parseByteSize(result[1]);
+        core->resizeBuffer(pool_size);
+        out << "Buffer Pool Resized to " << pool_size << " Bytes." << endl;
+    }
+    else if (regex_match(input, result, fill_factor_pattern)) {
+        double fill = stod(result[1]);
+        core->setFillFactor(fill);
+        out << "Index Fill Factor Set to " << fill << "." << endl;
+    }
+    else if (regex_match(input, result, parallel_pattern)) {
+        int degree = 0;
+        try { degree = stoi(result[1]); }
+        catch (...) {}
+        if (degree < 1 || degree > MAX_PARALLELISM) throw MiniSQLException("Illegal Parallelism!");
+        parallelism = degree;
+        out << "Parallelism Set to " << degree << "." << endl;
     }
     else if (regex_match(input, result, quit_pattern)) {
         out << "Quitting MiniSQL. See You Next Time~" << endl;
@@ -231,17 +286,17 @@ void Interpreter::parse_input(const string &input) {
     
     end = clock();
     double time = double(end - start) / CLOCKS_PER_SEC;
-    cout << "Time Elapsed: " << time << "secs" << endl;
+    out << "Time Elapsed: " << time << "secs" << endl;
 }
 
 void Interpreter::start() {
-    char buffer[IOBUFFER_CAPACITY];
+    string buffer;//ܺܳ޳
     string input;
     
     while (true) {
         if (in.eof()) break;
         out << "MiniSQL>> ";
-        in.getline(buffer, IOBUFFER_CAPACITY, ';');
+        getline(in, buffer, ';');
         in.ignore(1);
         input = regex_replace(buffer, regex("\\s+"), " ");
         trim(input);
@@ -252,20 +307,27 @@ void Interpreter::start() {
         } catch (InterpreterQuit) {
             break;
         } catch (MiniSQLException &e) {
-            cout << "Error: " << e.getMessage() << endl;
+            out << "Error: " << e.getMessage() << endl;
         }
-        cout << "------------------------------------" << endl << endl;
+        out << "------------------------------------" << endl << endl;
     }
 }
 
 
-void Interpreter_test() {
-    BufferManager BM;
+void Interpreter_test(size_t pool_size, ReplacePolicy policy, const FlushConfig &config, bool mapped_reads) {
+    LogManager LM;
+    BufferManager BM(pool_size, policy, &LM);
     CatalogManager CM(META_TABLE_FILE_PATH, META_INDEX_FILE_PATH);
+    LM.recover(&CM);
     RecordManager RM(&BM);
     IndexManager IM(&BM);
-    API core(&CM, &RM, &IM);
+    API core(&CM, &RM, &IM, &BM, &LM);
+    if (mapped_reads) BM.enableMappedReads();
+    BM.startWriter(config.writer_rate);
+    core.startCheckpointer(config);
 
     Interpreter IO(&core, cin, cout);
     IO.start();
+    core.checkpoint();
+    cout << "Buffer Hits: " << BM.getHitCount() << ", Misses: " << BM.getMissCount() << endl;
 }
\ No newline at end of file
@@ -7,9 +7,7 @@
 #include <regex>
 using namespace std;
 
-#define IOBUFFER_CAPACITY 1000
-
-string &trim(string &str) {
+inline string &trim(string &str) {
     str.erase(0, str.find_first_not_of(" "));
     str.erase(str.find_last_not_of(" ") + 1);
     return str;
@@ -19,13 +17,14 @@ class InterpreterQuit {};
 
 class Interpreter {
 public:
-    Interpreter(API *core, istream &in, ostream &out) : core(core), in(in), out(out) {};
+    Interpreter(API *core, istream &in, ostream &out, int parallelism = 1) : core(core), in(in), out(out), parallelism(parallelism) {};
 
     Type getType(const string &type_string);
 
     void parse_input(const string &input);
     void parse_table_definition(const string &tablename, string &content, smatch &result);
-    void parse_insert_value(const string &tablename, string &content, smatch &result);
+    void parse_insert_value(string &content, smatch &result, Record &record);
+    void split_insert_tuples(const string &tuples, std::vector<string> &contents);
     void parse_condition(string &content, smatch &result, Predicate &pred);
 
     void start();
@@ -33,15 +32,21 @@ private:
     API *core;
     istream &in;
     ostream &out;
+    int parallelism;//Ựȫɨ߳
 
     const regex create_table_pattern = regex("create table (\\w+)\\s?\\(([\\s\\S]+)\\)");
     const regex drop_table_pattern = regex("drop table (\\w+)\\s?");
     const regex create_index_pattern = regex("create index (\\w+) on (\\w+)\\s?\\(\\s?([^\\)]+?)\\s?\\)");
     const regex drop_index_pattern = regex("drop index (\\w+) on (\\w+)");
-    const regex insert_pattern = regex("insert into (\\w+) values\\s?\\(([^\\)]*)\\)");
+    const regex insert_pattern = regex("insert into (\\w+) values\\s?");//ֻƥͷĸԪз
     const regex select_pattern = regex("select \\* from (\\w+)(?: where ([\\s\\S]+))?");
     const regex delete_pattern = regex("delete from (\\w+)(?: where ([\\s\\S]+))?");
+    const regex load_pattern = regex("load data (?:'|\")([^'\"]+)(?:'|\") into (\\w+)( binary)?( defer index)?\\s?");
+    const regex vacuum_pattern = regex("vacuum (\\w+)\\s?");
     const regex execfile_pattern = regex("execfile ([\\s\\S]+)");
+    const regex buffer_pool_pattern = regex("set buffer pool (\\w+)");
+    const regex fill_factor_pattern = regex("set fill factor (\\d+(\\.\\d+)?)");
+    const regex parallel_pattern = regex("set parallel (\\d+)");
     const regex quit_pattern = regex("quit");
 
     const regex attr_definition_pattern = regex("\\s?(\\w+) (int|float|char\\([0-9]+\\))( unique)?\\s?");
@@ -52,5 +57,5 @@ private:
     const regex string_pattern = regex("(?:\"|')([\\s\\S]+)(?:\"|')");
     const regex condition_pattern = regex("(\\w+)\\s?(<=|>=|<>|=|<|>)\\s?([\\s\\S]+?)(?: and ([\\s\\S]+))?");
 
-    void showResult(const Table &table, const ReturnTable &T);
+    int showResult(RecordCursor &cursor);
 };
\ No newline at end of file
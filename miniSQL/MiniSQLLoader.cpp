@@ -0,0 +1,120 @@
+#include "MiniSQLLoader.h"
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+
+RowReader *RowReader::create(const string &filename, const Table &table, bool binary) {
+    if (binary) return new BinaryReader(filename, table);
+    return new CSVReader(filename, table);
+}
+
+CSVReader::CSVReader(const string &filename, const Table &table) : inf(filename), table(table), line_number(0) {
+    if (!inf.is_open()) throw MiniSQLException("File Doesn't Exist!");
+}
+
+MiniSQLException CSVReader::error(const string &message) const {
+    return MiniSQLException(message + " (Line " + std::to_string(line_number) + ")");
+}
+
+bool CSVReader::next(Record &record) {
+    string line;
+    vector<string> fields;
+    while (std::getline(inf, line)) {
+        line_number++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.find_first_not_of(" \t") == string::npos) continue;
+
+        splitFields(line, fields);
+        if (fields.size() != table.attrs.size()) throw error("Wrong Number of Inserted Values!");
+        record.clear();
+        record.reserve(fields.size());
+        for (size_t i = 0; i < fields.size(); i++) record.push_back(parseField(fields[i], table.attrs[i]));
+        return true;
+    }
+    return false;
+}
+
+//з֣ڵĶŲ㣻ȥ˿հ׺
+void CSVReader::splitFields(const string &line, vector<string> &fields) const {
+    fields.clear();
+    string field;
+    char quote = 0;
+    bool quoted = false;
+    for (char c : line) {
+        if (quote) {
+            if (c == quote) quote = 0;
+            else field.push_back(c);
+        }
+        else if (c == '\'' || c == '"') {
+            if (field.find_first_not_of(" \t") == string::npos) field.clear();//ǰĿհײ
+            quote = c;
+            quoted = true;
+        }
+        else if (c == ',') {
+            if (!quoted) {
+                field.erase(0, field.find_first_not_of(" \t"));
+                field.erase(field.find_last_not_of(" \t") + 1);
+            }
+            fields.push_back(field);
+            field.clear();
+            quoted = false;
+        }
+        else if (!quoted || (c != ' ' && c != '\t')) field.push_back(c);
+    }
+    if (quote) throw error("Unclosed Quote!");
+    if (!quoted) {
+        field.erase(0, field.find_first_not_of(" \t"));
+        field.erase(field.find_last_not_of(" \t") + 1);
+    }
+    fields.push_back(field);
+}
+
+Value CSVReader::parseField(const string &field, const Attr &attr) const {
+    const char *begin = field.c_str();
+    char *end;
+    errno = 0;
+    switch (attr.type.btype) {
+    case BaseType::INT: {
+        long value = strtol(begin, &end, 10);
+        if (field.empty() || *end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) throw error("Illegal Inserted Value!");
+        int data = (int)value;
+        return Value(attr.type, &data);
+    }
+    case BaseType::FLOAT: {
+        float data = strtof(begin, &end);
+        if (field.empty() || *end != '\0') throw error("Illegal Inserted Value!");
+        return Value(attr.type, &data);
+    }
+    case BaseType::CHAR:
+    default:
+        if (field.size() + 1 > attr.type.size) throw error("Type Incompatible!");
+        return Value(Type(BaseType::CHAR, field.size() + 1), begin);
+    }
+}
+
+BinaryReader::BinaryReader(const string &filename, const Table &table) : table(table), row(table.record_length - sizeof(bool)), row_number(0) {
+    if (fopen_s(&fp, filename.data(), "rb") != 0) throw MiniSQLException("File Doesn't Exist!");
+}
+
+BinaryReader::~BinaryReader() {
+    fclose(fp);
+}
+
+bool BinaryReader::next(Record &record) {
+    size_t read = fread(row.data(), 1, row.size(), fp);
+    if (read == 0) return false;
+    row_number++;
+    if (read != row.size()) throw MiniSQLException("Truncated Binary Row! (Row " + std::to_string(row_number) + ")");
+
+    record.clear();
+    record.reserve(table.attrs.size());
+    const char *p = row.data();
+    for (const auto &attr : table.attrs) {
+        if (attr.type.btype == BaseType::CHAR && p[attr.type.size - 1] != '\0') {
+            throw MiniSQLException("Unterminated String in Binary Row! (Row " + std::to_string(row_number) + ")");
+        }
+        record.push_back(Value(attr.type, p));
+        p += attr.type.size;
+    }
+    return true;
+}
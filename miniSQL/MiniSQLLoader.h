@@ -0,0 +1,66 @@
+#pragma once
+
+#include "MiniSQLCatalogManager.h"
+#include "MiniSQLException.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+using std::string;
+using std::vector;
+
+/*                                          */
+/*                                          */
+/*              ļȡ                */
+/*                                          */
+/*                                          */
+
+//жӵļж¼Valueһ
+class RowReader {
+public:
+    virtual ~RowReader() = default;
+
+    //һУ귵false
+    virtual bool next(Record &record) = 0;
+
+    static RowReader *create(const string &filename, const Table &table, bool binary);
+};
+
+/*                                          */
+/*                  CSV                     */
+/*                                          */
+
+//ÿһ¼Զŷַָõ/˫пɺţ
+class CSVReader : public RowReader {
+public:
+    CSVReader(const string &filename, const Table &table);
+
+    bool next(Record &record) override;
+private:
+    void splitFields(const string &line, vector<string> &fields) const;
+    Value parseField(const string &field, const Attr &attr) const;
+    MiniSQLException error(const string &message) const;
+
+    std::ifstream inf;
+    const Table &table;
+    int line_number;
+};
+
+/*                                          */
+/*                                  */
+/*                                          */
+
+//ûļͷÿΪеĶݣ(record_length-1)ֽڣļеļ¼ͬvalidλ
+//intΪ4ֽڡfloatΪ4ֽIEEEȣΪСˣchar(n)ռnֽڣݺ'\0'һֽڱ'\0'
+class BinaryReader : public RowReader {
+public:
+    BinaryReader(const string &filename, const Table &table);
+    ~BinaryReader();
+
+    bool next(Record &record) override;
+private:
+    FILE *fp;
+    const Table &table;
+    vector<char> row;
+    int row_number;
+};
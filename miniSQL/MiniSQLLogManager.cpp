@@ -0,0 +1,467 @@
+#include "MiniSQLLogManager.h"
+#include "MiniSQLCatalogManager.h"
+#include "MiniSQLException.h"
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <map>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#define INVALID_FILE_HANDLE INVALID_HANDLE_VALUE
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#define INVALID_FILE_HANDLE (-1)
+#endif
+
+#define LOG_HEADER_SIZE (2 * sizeof(uint32_t))   //¼ͷ¼ܳݵУ
+#define LOG_COPY_SIZE (1 << 20)   //ض־ʱÿθƵֽ
+
+/*                                          */
+/*                ļд                  */
+/*                                          */
+
+//ļcreateʱ½
+static FileHandle openLogFile(const string &filename, bool create) {
+#ifdef _WIN32
+    return CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    return open(filename.c_str(), create ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+#endif
+}
+
+static void closeLogFile(FileHandle fd) {
+#ifdef _WIN32
+    CloseHandle(fd);
+#else
+    close(fd);
+#endif
+}
+
+static size_t readLogAt(FileHandle fd, char *buffer, size_t length, long long offset) {
+#ifdef _WIN32
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD read = 0;
+    if (!ReadFile(fd, buffer, (DWORD)length, &read, &ov) && GetLastError() != ERROR_HANDLE_EOF) return 0;
+    return read;
+#else
+    ssize_t read = pread(fd, buffer, length, offset);
+    return (read < 0) ? 0 : (size_t)read;
+#endif
+}
+
+static bool writeLogAt(FileHandle fd, const char *buffer, size_t length, long long offset) {
+#ifdef _WIN32
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD written = 0;
+    return WriteFile(fd, buffer, (DWORD)length, &written, &ov) && written == length;
+#else
+    return pwrite(fd, buffer, length, offset) == (ssize_t)length;
+#endif
+}
+
+static bool syncLogFile(FileHandle fd) {
+#ifdef _WIN32
+    return FlushFileBuffers(fd) != 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+static bool truncateLogFile(FileHandle fd) {
+#ifdef _WIN32
+    LARGE_INTEGER zero = {};
+    return SetFilePointerEx(fd, zero, NULL, FILE_BEGIN) && SetEndOfFile(fd);
+#else
+    return ftruncate(fd, 0) == 0;
+#endif
+}
+
+static long long logFileSize(FileHandle fd) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fd, &size)) return -1;
+    return size.QuadPart;
+#else
+    return lseek(fd, 0, SEEK_END);
+#endif
+}
+
+static bool fileExists(const string &filename) {
+    FILE *fp;
+    if (fopen_s(&fp, filename.data(), "rb") != 0) return false;
+    fclose(fp);
+    return true;
+}
+
+/*                                          */
+/*               ¼                   */
+/*                                          */
+
+struct CrcTable {
+    uint32_t entry[256];
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            entry[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const char *data, size_t length) {
+    static const CrcTable table;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) crc = table.entry[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+//¼ܳУ͡ࡢţ֮ǸֶΡд
+class RecordWriter {
+public:
+    RecordWriter(LogType type, int txn) : data(LOG_HEADER_SIZE, 0) {
+        data.push_back((char)type);
+        putInt(txn);
+    }
+    void putInt(int32_t value) { data.append((const char*)&value, sizeof(value)); }
+    void putBool(bool value) { data.push_back(value ? 1 : 0); }
+    void putString(const string &str) {
+        putInt((int32_t)str.size());
+        data.append(str);
+    }
+    const string &finish() {
+        uint32_t length = (uint32_t)data.size();
+        uint32_t checksum = crc32(data.data() + LOG_HEADER_SIZE, data.size() - LOG_HEADER_SIZE);
+        memcpy(&data[0], &length, sizeof(length));
+        memcpy(&data[sizeof(length)], &checksum, sizeof(checksum));
+        return data;
+    }
+private:
+    string data;
+};
+
+class RecordReader {
+public:
+    RecordReader(const string &data) : data(data), pos(0) {}
+    bool getInt(int32_t &value) {
+        if (pos + sizeof(value) > data.size()) return false;
+        memcpy(&value, data.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+    bool getBool(bool &value) {
+        if (pos + 1 > data.size()) return false;
+        value = data[pos++] != 0;
+        return true;
+    }
+    bool getString(string &str) {
+        int32_t length;
+        if (!getInt(length) || length < 0 || pos + length > data.size()) return false;
+        str.assign(data, pos, length);
+        pos += length;
+        return true;
+    }
+private:
+    const string &data;
+    size_t pos;
+};
+
+/*                                          */
+/*                 ־                     */
+/*                                          */
+
+LogManager::LogManager(const string &filename) : filename(filename), last_txn(0), flushing(false) {
+    fd = openLogFile(filename, true);
+    if (fd == INVALID_FILE_HANDLE) throw MiniSQLException("Fail to open log file!");
+    base = 0;
+    appended_lsn = durable_lsn = logFileSize(fd);
+}
+
+LogManager::~LogManager() {
+    try { flushAll(); }
+    catch (MiniSQLException &) {}
+    closeLogFile(fd);
+}
+
+long long LogManager::append(int txn, const string &record) {
+    std::lock_guard<std::mutex> lock(latch);
+    if (txn != 0 && first_lsn.find(txn) == first_lsn.end()) first_lsn[txn] = appended_lsn;
+    pending += record;
+    appended_lsn += record.size();
+    return appended_lsn;
+}
+
+long long LogManager::getLSN() {
+    std::lock_guard<std::mutex> lock(latch);
+    return appended_lsn;
+}
+
+void LogManager::end(int txn) {
+    std::lock_guard<std::mutex> lock(latch);
+    first_lsn.erase(txn);
+}
+
+long long LogManager::getActiveLSN() {
+    std::lock_guard<std::mutex> lock(latch);
+    long long lsn = appended_lsn;
+    for (const auto &txn : first_lsn) lsn = std::min(lsn, txn.second);
+    return lsn;
+}
+
+long long LogManager::getLogSize() {
+    std::lock_guard<std::mutex> lock(latch);
+    return appended_lsn - base;
+}
+
+long long LogManager::logPage(int txn, const string &filename, int block_id, const char *image, bool undo) {
+    RecordWriter record(undo ? LogType::UNDO : LogType::PAGE, txn);
+    record.putString(filename);
+    record.putInt(block_id);
+    record.putString(string(image, PAGESIZE));
+    return append(txn, record.finish());
+}
+
+long long LogManager::logCreate(int txn, const string &filename) {
+    RecordWriter record(LogType::CREATE, txn);
+    record.putString(filename);
+    return append(txn, record.finish());
+}
+
+long long LogManager::logDrop(int txn, const string &filename, bool backup) {
+    RecordWriter record(LogType::DROP, txn);
+    record.putString(filename);
+    record.putBool(backup);
+    return append(txn, record.finish());
+}
+
+long long LogManager::logReplace(int txn, const string &filename, const string &new_filename, bool backup) {
+    RecordWriter record(LogType::REPLACE, txn);
+    record.putString(filename);
+    record.putString(new_filename);
+    record.putBool(backup);
+    return append(txn, record.finish());
+}
+
+long long LogManager::logCatalog(int txn, const string &tablename, const string &text) {
+    RecordWriter record(LogType::CATALOG, txn);
+    record.putString(tablename);
+    record.putString(text);
+    return append(txn, record.finish());
+}
+
+long long LogManager::logCommit(int txn) {
+    RecordWriter record(LogType::COMMIT, txn);
+    return append(txn, record.finish());
+}
+
+/*
+ύû߳дʱɵǰ߳ȡµȫ¼ſдfsync
+дڼ߳׷ӵļ¼͵ȴ̵һ֣һfsyncʹύͬʱ
+*/
+void LogManager::flush(long long lsn) {
+    std::unique_lock<std::mutex> lock(latch);
+    if (lsn > appended_lsn) lsn = appended_lsn;
+    while (durable_lsn < lsn) {
+        if (flushing) {
+            flushed.wait(lock);
+            continue;
+        }
+        flushing = true;
+        string data;
+        data.swap(pending);
+        long long start = durable_lsn;
+        long long end = appended_lsn;
+        lock.unlock();
+
+        bool ok = writeLogAt(fd, data.data(), data.size(), start - base) && syncLogFile(fd);
+
+        lock.lock();
+        flushing = false;
+        if (ok) durable_lsn = end;
+        else pending = data + pending;//
+        flushed.notify_all();
+        if (!ok) throw MiniSQLException("Fail to write log!");
+    }
+}
+
+/*
+lsn֮ǰ־lsn̵֮ĲָƵļˢ̺滻ԭ־ļ;ʱ¾ļһ
+ڼռдλã׷ճУȴ̵̵߳ȸ
+*/
+void LogManager::truncate(long long lsn) {
+    flush(lsn);
+    std::unique_lock<std::mutex> lock(latch);
+    flushed.wait(lock, [this] { return !flushing; });
+    if (lsn <= base) return;
+    if (lsn >= durable_lsn) {
+        if (!truncateLogFile(fd) || !syncLogFile(fd)) throw MiniSQLException("Fail to truncate log!");
+        base = lsn;
+        return;
+    }
+    flushing = true;
+    long long start = lsn - base, end = durable_lsn - base;
+    lock.unlock();
+
+    string tmp_filename = filename + ".tmp";
+    FileHandle tmp = openLogFile(tmp_filename, true);
+    bool ok = tmp != INVALID_FILE_HANDLE && truncateLogFile(tmp);
+    vector<char> buffer(LOG_COPY_SIZE);
+    for (long long offset = start; ok && offset < end; offset += LOG_COPY_SIZE) {
+        size_t length = (size_t)std::min<long long>(LOG_COPY_SIZE, end - offset);
+        ok = readLogAt(fd, buffer.data(), length, offset) == length && writeLogAt(tmp, buffer.data(), length, offset - start);
+    }
+    ok = ok && syncLogFile(tmp);
+    if (tmp != INVALID_FILE_HANDLE) closeLogFile(tmp);
+    bool opened = true;
+    if (ok) {
+        closeLogFile(fd);
+        ok = moveFile(tmp_filename, filename);
+        fd = openLogFile(filename, true);
+        opened = fd != INVALID_FILE_HANDLE;
+    }
+
+    //ҲҪеˢ̵߳
+    lock.lock();
+    flushing = false;
+    if (ok) base = lsn;
+    flushed.notify_all();
+    if (!opened) throw MiniSQLException("Fail to open log file!");
+    if (!ok) throw MiniSQLException("Fail to truncate log!");
+}
+
+//offsetһ¼ȻУͲԣдһʱfalse
+bool LogManager::readRecord(long long offset, LogRecord &record, long long &next) {
+    uint32_t header[2];
+    if (readLogAt(fd, (char*)header, sizeof(header), offset) != sizeof(header)) return false;
+    uint32_t length = header[0];
+    if (length < LOG_HEADER_SIZE + 1 + sizeof(int32_t) || length > LOG_HEADER_SIZE + 2 * PAGESIZE + (1 << 20)) return false;
+    string body(length - LOG_HEADER_SIZE, 0);
+    if (readLogAt(fd, &body[0], body.size(), offset + LOG_HEADER_SIZE) != body.size()) return false;
+    if (crc32(body.data(), body.size()) != header[1]) return false;
+
+    record.type = (LogType)body[0];
+    body.erase(0, 1);
+    RecordReader reader(body);
+    int32_t txn, block_id = 0;
+    if (!reader.getInt(txn)) return false;
+    record.txn = txn;
+    bool ok = true;
+    switch (record.type) {
+    case LogType::PAGE:
+    case LogType::UNDO:
+        ok = reader.getString(record.filename) && reader.getInt(block_id) && reader.getString(record.image) && record.image.size() == PAGESIZE;
+        record.block_id = block_id;
+        break;
+    case LogType::CREATE:    ok = reader.getString(record.filename); break;
+    case LogType::DROP:    ok = reader.getString(record.filename) && reader.getBool(record.backup); break;
+    case LogType::REPLACE:    ok = reader.getString(record.filename) && reader.getString(record.extra) && reader.getBool(record.backup); break;
+    case LogType::CATALOG:    ok = reader.getString(record.filename) && reader.getString(record.extra); break;
+    case LogType::COMMIT:    break;
+    default:    ok = false;
+    }
+    next = offset + length;
+    return ok;
+}
+
+/*
+ָ
+ҳύ¼δύдҳԭݣɾ½ļļĻ
+ٰ־˳ύдҳݣɾ滻ļָϢ
+ͬһļͬʱֻһڸģụา
+*/
+void LogManager::recover(CatalogManager *CM) {
+    vector<long long> offsets;
+    std::map<int, bool> committed;
+    long long size = logFileSize(fd);
+    long long offset = 0, next;
+    LogRecord record;
+    while (offset < size && readRecord(offset, record, next)) {
+        offsets.push_back(offset);
+        if (record.type == LogType::COMMIT) committed[record.txn] = true;
+        offset = next;
+    }
+    if (offsets.empty()) {
+        truncate(getLSN());
+        return;
+    }
+
+    //ָڼ򿪵ļ
+    std::map<string, FileHandle> files;
+    auto closeFile = [&](const string &filename) {
+        auto it = files.find(filename);
+        if (it == files.end()) return;
+        syncLogFile(it->second);
+        closeLogFile(it->second);
+        files.erase(it);
+    };
+    auto writePage = [&](const LogRecord &record) {
+        auto it = files.find(record.filename);
+        if (it == files.end()) {
+            FileHandle file = openLogFile(record.filename, true);
+            if (file == INVALID_FILE_HANDLE) throw MiniSQLException("Fail to open file!");
+            it = files.insert(std::make_pair(record.filename, file)).first;
+        }
+        if (!writeLogAt(it->second, record.image.data(), PAGESIZE, (long long)PAGESIZE * record.block_id)) throw MiniSQLException("Fail to write file!");
+    };
+    auto moveOver = [&](const string &from, const string &to) {
+        closeFile(from);
+        closeFile(to);
+        if (fileExists(from) && !moveFile(from, to)) throw MiniSQLException("Fail to replace file!");
+    };
+    auto removeFile = [&](const string &filename) {
+        closeFile(filename);
+        remove(filename.data());
+    };
+
+    for (auto it = offsets.rbegin(); it != offsets.rend(); it++) {
+        readRecord(*it, record, next);
+        if (committed.count(record.txn)) continue;
+        switch (record.type) {
+        case LogType::UNDO:    writePage(record); break;
+        case LogType::CREATE:    removeFile(record.filename); break;
+        case LogType::DROP:    if (record.backup) moveOver(BACKUP_FILE_PATH(record.filename), record.filename); break;
+        case LogType::REPLACE:
+            removeFile(record.extra);
+            if (record.backup) moveOver(BACKUP_FILE_PATH(record.filename), record.filename);
+            break;
+        default:    break;
+        }
+    }
+
+    for (auto it = offsets.begin(); it != offsets.end(); it++) {
+        readRecord(*it, record, next);
+        if (!committed.count(record.txn)) continue;
+        switch (record.type) {
+        case LogType::PAGE:    writePage(record); break;
+        case LogType::CREATE: {
+            removeFile(record.filename);
+            FileHandle file = openLogFile(record.filename, true);
+            if (file == INVALID_FILE_HANDLE) throw MiniSQLException("Fail to create file!");
+            files[record.filename] = file;
+            break;
+        }
+        case LogType::DROP:
+            removeFile(record.filename);
+            removeFile(BACKUP_FILE_PATH(record.filename));
+            break;
+        case LogType::REPLACE:
+            moveOver(record.extra, record.filename);
+            removeFile(BACKUP_FILE_PATH(record.filename));
+            break;
+        case LogType::CATALOG:    CM->restoreTable(record.filename, record.extra); break;
+        default:    break;
+        }
+    }
+
+    while (!files.empty()) closeFile(files.begin()->first);
+    CM->save();
+    truncate(getLSN());
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "MiniSQLBufferManager.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+using std::string;
+using std::vector;
+
+#define LOG_FILE_PATH "../miniSQL.wal"
+#define BACKUP_FILE_PATH(filename) ((filename) + ".old")   //ɾ滻ļȸύɾ
+
+class CatalogManager;
+
+//־¼
+enum class LogType : unsigned char {
+    PAGE = 1,//ҳݣã
+    UNDO,//ҳдǰϵԭݣã
+    CREATE,//½ļ
+    DROP,//ɾļ
+    REPLACE,//һļ滻
+    CATALOG,//һűıϢϢ
+    COMMIT//ύ
+};
+
+struct LogRecord {
+    LogType type;
+    int txn;//
+    string filename;//CATALOGʱΪ
+    string extra;//REPLACEʱΪļCATALOGʱΪϢ
+    int block_id;
+    bool backup;//DROP/REPLACEʱԭļǷ
+    string image;//PAGE/UNDOʱҳ
+};
+
+/*                                          */
+/*                                          */
+/*             Ԥд־/        */
+/*                                          */
+/*                                          */
+
+/*
+һ޸ݵһĹҳύʱҳд־ͬϢύ¼־̺ŷأ
+ҳɺ̨д̡߳дءδύҳʱȼ´ϵԭдء
+־ڴţȴ̵߳һһдһfsyncĵ꣨ύ
+ʱҪĿͷ֣еļ¼ύδдصҳļ¼Ҫš
+ʱȳδύٰ˳ύȻдرϢ־
+*/
+class LogManager {
+public:
+    LogManager(const string &filename = LOG_FILE_PATH);
+    LogManager(const LogManager &) = delete;
+    ~LogManager();
+
+    //
+    int begin() { return ++last_txn; }
+    //ύҪļ¼
+    void end(int txn);
+
+    //°һ¼׷ӵڴ棬ؼ¼ĩβλãLSN
+    long long logPage(int txn, const string &filename, int block_id, const char *image, bool undo = false);
+    long long logCreate(int txn, const string &filename);
+    long long logDrop(int txn, const string &filename, bool backup);
+    long long logReplace(int txn, const string &filename, const string &new_filename, bool backup);
+    long long logCatalog(int txn, const string &tablename, const string &text);
+    long long logCommit(int txn);
+
+    //־̵lsnΪֹ
+    void flush(long long lsn);
+    void flushAll() { flush(getLSN()); }
+    long long getLSN();
+    //еļ¼λãûʱΪgetLSN()
+    long long getActiveLSN();
+    //־ļеֽ
+    long long getLogSize();
+
+    //lsn֮ǰļ¼뱣ָ֤ʱòǣ㣩
+    void truncate(long long lsn);
+
+    //ʱط־дرϢ־
+    void recover(CatalogManager *CM);
+
+private:
+    long long append(int txn, const string &record);
+    bool readRecord(long long offset, LogRecord &record, long long &next);
+
+    string filename;
+    FileHandle fd;
+    std::atomic<int> last_txn;
+
+    //¸
+    std::mutex latch;
+    std::condition_variable flushed;
+    string pending;//׷ӡδдļ¼
+    long long base;//־ļͷӦLSN־LSN
+    long long appended_lsn;
+    long long durable_lsn;
+    bool flushing;//߳дڽض
+    std::map<int, long long> first_lsn;//еĵһ¼λ
+};
@@ -1,48 +1,72 @@
 #include "MiniSQLMeta.h"
 #include <iostream>
 
+void Value::allocate() {
+    data = (type.size <= VALUE_INLINE_SIZE) ? static_cast<void*>(inline_data) : new char[type.size];
+}
+
+void Value::release() {
+    if (!isInline()) delete[](char*)data;
+    data = inline_data;
+}
+
 Value::Value(Type type, const void *data) : type(type) {
     if (data == nullptr) throw MiniSQLException("NULL Value!");
-    this->data = new char[type.size];
+    allocate();
     memcpy_s(this->data, type.size, data, type.size);
 }
 
 Value::Value(const Value &rhs) : type(rhs.type) {
-    if (data == nullptr) throw MiniSQLException("NULL Value!");
-    data = new char[type.size];
+    if (rhs.data == nullptr) throw MiniSQLException("NULL Value!");
+    allocate();
     memcpy_s(data, type.size, rhs.data, type.size);
 }
 
-template<typename T>
-typename std::enable_if<std::is_pointer<T>::value, T>::type Value::translate() const {
-    if (std::is_same<T, char*>::value) return reinterpret_cast<T>(data);
-    else throw MiniSQLException("Type Unsupported!");
+Value::Value(Value &&rhs) : type(rhs.type) {
+    if (rhs.isInline()) {
+        data = inline_data;
+        memcpy_s(data, VALUE_INLINE_SIZE, rhs.data, type.size);
+    }
+    else {//ӹܶڴ
+        data = rhs.data;
+        rhs.data = rhs.inline_data;
+        rhs.type.size = 0;
+    }
 }
 
-template<typename T>
-typename std::enable_if<!std::is_pointer<T>::value, T>::type Value::translate() const {
-    if (std::is_same<T, int>::value) {
-        if (type.btype == BaseType::INT) return *reinterpret_cast<int*>(data);
-        else if (type.btype == BaseType::FLOAT) return (int)*reinterpret_cast<float*>(data);
-        else throw MiniSQLException("Type Incompatible!");
+Value &Value::operator=(const Value &rhs) {
+    if (this != &rhs) {
+        release();
+        type = rhs.type;
+        allocate();
+        memcpy_s(data, type.size, rhs.data, type.size);
     }
-    else if (std::is_same<T, float>::value) {
-        if (type.btype == BaseType::INT) return (float)*reinterpret_cast<int*>(data);
-        else if (type.btype == BaseType::FLOAT) return *reinterpret_cast<float*>(data);
-        else throw MiniSQLException("Type Incompatible!");
+    return *this;
+}
+
+Value &Value::operator=(Value &&rhs) {
+    if (this != &rhs) {
+        release();
+        type = rhs.type;
+        if (rhs.isInline()) memcpy_s(data, VALUE_INLINE_SIZE, rhs.data, type.size);
+        else {
+            data = rhs.data;
+            rhs.data = rhs.inline_data;
+            rhs.type.size = 0;
+        }
     }
-    else throw MiniSQLException("Type Unsupported!");
+    return *this;
 }
 
 void Value::convertTo(const Type &rtype) {
     if (type.btype == rtype.btype) {
-        if (type.btype == BaseType::CHAR) {
+        if (type.btype == BaseType::CHAR && type.size != rtype.size) {
             if (type.size > rtype.size) throw MiniSQLException("Type Incompatible!");
-            char *new_data = new char[rtype.size];
-            memcpy_s(new_data, rtype.size, data, type.size);
-            delete data;
-            data = new_data;
-            type.size = rtype.size;
+            Value old(std::move(*this));
+            type = rtype;
+            allocate();
+            memset(data, 0, type.size);
+            memcpy_s(data, type.size, old.data, old.type.size);
         }
     }
     else if (type.btype == BaseType::INT && rtype.btype == BaseType::FLOAT) {
@@ -53,25 +77,41 @@ void Value::convertTo(const Type &rtype) {
     else throw MiniSQLException("Type Incompatible!");
 }
 
+//ݿδ루ҳеУֵmemcpyȡ
+int Value::compare(const Type &ltype, const void *ldata, const Type &rtype, const void *rdata) {
+    if (ltype.btype == BaseType::CHAR && rtype.btype == BaseType::CHAR) return strcmp((const char*)ldata, (const char*)rdata);
+    if (ltype.btype == BaseType::CHAR || rtype.btype == BaseType::CHAR) throw MiniSQLException("Comparation unsupported!");
+    if (ltype.btype == BaseType::INT && rtype.btype == BaseType::INT) {
+        int lvalue, rvalue;
+        memcpy(&lvalue, ldata, sizeof(int));
+        memcpy(&rvalue, rdata, sizeof(int));
+        return (lvalue < rvalue) ? -1 : (lvalue > rvalue);
+    }
+    float lvalue, rvalue;
+    if (ltype.btype == BaseType::INT) {
+        int i;
+        memcpy(&i, ldata, sizeof(int));
+        lvalue = (float)i;
+    }
+    else memcpy(&lvalue, ldata, sizeof(float));
+    if (rtype.btype == BaseType::INT) {
+        int i;
+        memcpy(&i, rdata, sizeof(int));
+        rvalue = (float)i;
+    }
+    else memcpy(&rvalue, rdata, sizeof(float));
+    return (lvalue < rvalue) ? -1 : (lvalue > rvalue);
+}
+
 bool Value::operator==(const Value &rhs) const {
-    if (type.btype == BaseType::CHAR && rhs.type.btype == BaseType::CHAR) return strcmp(this->translate<char*>(), rhs.translate<char*>()) == 0;
-    if (type.btype == BaseType::CHAR || rhs.type.btype == BaseType::CHAR) throw MiniSQLException("Comparation unsupported!");
-    if (type.btype == BaseType::INT && rhs.type.btype == BaseType::INT) return (translate<int>() == rhs.translate<int>());
-    float lvalue = (type.btype == BaseType::INT) ? (float)(translate<int>()) : translate<float>();
-    float rvalue = (rhs.type.btype == BaseType::INT) ? (float)(rhs.translate<int>()) : rhs.translate<float>();
-    return lvalue == rvalue;
+    return compare(type, data, rhs.type, rhs.data) == 0;
 }
 
 bool Value::operator<(const Value &rhs) const {
-    if (type.btype == BaseType::CHAR && rhs.type.btype == BaseType::CHAR) return strcmp(this->translate<char*>(), rhs.translate<char*>()) < 0;
-    if (type.btype == BaseType::CHAR || rhs.type.btype == BaseType::CHAR) throw MiniSQLException("Comparation unsupported!");
-    if (type.btype == BaseType::INT && rhs.type.btype == BaseType::INT) return (translate<int>() < rhs.translate<int>());
-    float lvalue = (type.btype == BaseType::INT) ? (float)(translate<int>()) : translate<float>();
-    float rvalue = (rhs.type.btype == BaseType::INT) ? (float)(rhs.translate<int>()) : rhs.translate<float>();
-    return lvalue < rvalue;
+    return compare(type, data, rhs.type, rhs.data) < 0;
 }
 
-std::ostream &operator<<(std::ostream &os, Value value) {
+std::ostream &operator<<(std::ostream &os, const Value &value) {
     if (value.type.btype == BaseType::INT) {
         os << value.translate<int>();
     }
@@ -6,6 +6,8 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstring>
+#include <type_traits>
 
 #define META_TABLE_FILE_PATH "../META_TABLE.table"
 #define META_INDEX_FILE_PATH "../META_INDEX.table"
@@ -40,10 +42,15 @@ struct Type {
     }
 };
 
+#define VALUE_INLINE_SIZE 16   //˳ȵֱֵӴValueڲڴ
+
 struct Value {
     Value(Type type, const void *data);
     Value(const Value &rhs);
-    ~Value() { delete[](char*)data; };
+    Value(Value &&rhs);
+    Value &operator=(const Value &rhs);
+    Value &operator=(Value &&rhs);
+    ~Value() { release(); };
 
     template<typename T>
     typename std::enable_if<std::is_pointer<T>::value, T>::type translate() const;
@@ -53,6 +60,9 @@ struct Value {
 
     void convertTo(const Type &rtype);
 
+    //Ƚΰʹŵݣֱҳеݣظ/0/intfloat֮䰴floatȽ
+    static int compare(const Type &ltype, const void *ldata, const Type &rtype, const void *rdata);
+
     bool operator==(const Value &rhs) const;
     bool operator!=(const Value &rhs) const { return !(*this == rhs); }
     bool operator<(const Value &rhs) const;
@@ -63,9 +73,37 @@ struct Value {
     Type type;
     void *data;
 
-    friend std::ostream &operator<<(std::ostream &os, Value value);
+    friend std::ostream &operator<<(std::ostream &os, const Value &value);
+private:
+    //type.sizedataָڲ·Ķڴ
+    void allocate();
+    void release();
+    bool isInline() const { return data == inline_data; }
+
+    alignas(8) char inline_data[VALUE_INLINE_SIZE];
 };
 
+template<typename T>
+typename std::enable_if<std::is_pointer<T>::value, T>::type Value::translate() const {
+    if (std::is_same<T, char*>::value) return reinterpret_cast<T>(data);
+    else throw MiniSQLException("Type Unsupported!");
+}
+
+template<typename T>
+typename std::enable_if<!std::is_pointer<T>::value, T>::type Value::translate() const {
+    if (std::is_same<T, int>::value) {
+        if (type.btype == BaseType::INT) return *reinterpret_cast<int*>(data);
+        else if (type.btype == BaseType::FLOAT) return (int)*reinterpret_cast<float*>(data);
+        else throw MiniSQLException("Type Incompatible!");
+    }
+    else if (std::is_same<T, float>::value) {
+        if (type.btype == BaseType::INT) return (float)*reinterpret_cast<int*>(data);
+        else if (type.btype == BaseType::FLOAT) return *reinterpret_cast<float*>(data);
+        else throw MiniSQLException("Type Incompatible!");
+    }
+    else throw MiniSQLException("Type Unsupported!");
+}
+
 using Record = std::vector<Value>;
 
 typedef struct {
@@ -0,0 +1,137 @@
+#include "MiniSQLPredicate.h"
+#include <cstring>
+
+namespace {
+
+using Kernel = bool (*)(const char *row, const PredicateTerm &term);
+
+//opģswitchڱʱͶ
+template<Compare op, typename T>
+inline bool test(T lhs, T rhs) {
+    switch (op) {
+    case Compare::EQ:    return lhs == rhs;
+    case Compare::NE:    return lhs != rhs;
+    case Compare::LT:    return lhs < rhs;
+    case Compare::LE:    return lhs <= rhs;
+    case Compare::GT:    return lhs > rhs;
+    case Compare::GE:    return lhs >= rhs;
+    }
+    return false;
+}
+
+//еȡֵʽloadȡֵconstantȡȽϵĳintfloatȽʱfloat
+struct IntColumn {
+    static int load(const char *p, const PredicateTerm &) {
+        int value;
+        memcpy(&value, p, sizeof(int));
+        return value;
+    }
+    static int constant(const PredicateTerm &term) { return term.int_value; }
+};
+struct IntAsFloatColumn {
+    static float load(const char *p, const PredicateTerm &) {
+        int value;
+        memcpy(&value, p, sizeof(int));
+        return (float)value;
+    }
+    static float constant(const PredicateTerm &term) { return term.float_value; }
+};
+struct FloatColumn {
+    static float load(const char *p, const PredicateTerm &) {
+        float value;
+        memcpy(&value, p, sizeof(float));
+        return value;
+    }
+    static float constant(const PredicateTerm &term) { return term.float_value; }
+};
+struct CharColumn {//ȽϽ0
+    static int load(const char *p, const PredicateTerm &term) { return strncmp(p, term.string_value.c_str(), term.size); }
+    static int constant(const PredicateTerm &) { return 0; }
+};
+
+template<typename Column, Compare op>
+bool evaluate(const char *row, const PredicateTerm &term) {
+    return test<op>(Column::load(row + term.offset, term), Column::constant(term));
+}
+
+template<typename Column>
+Kernel selectKernel(Compare op) {
+    switch (op) {
+    case Compare::EQ:    return &evaluate<Column, Compare::EQ>;
+    case Compare::NE:    return &evaluate<Column, Compare::NE>;
+    case Compare::LT:    return &evaluate<Column, Compare::LT>;
+    case Compare::LE:    return &evaluate<Column, Compare::LE>;
+    case Compare::GT:    return &evaluate<Column, Compare::GT>;
+    case Compare::GE:    return &evaluate<Column, Compare::GE>;
+    default: throw MiniSQLException("Unsupported Comparation!");
+    }
+}
+
+}
+
+//ֵȽϱˣַȽǰɸ
+CompiledPredicate::CompiledPredicate(const Table &table, const Predicate &pred) {
+    vector<PredicateTerm> char_terms;
+    size_t offset = 0;
+    for (const auto &attr : table.attrs) {
+        auto conds = pred.find(attr.name);
+        if (pred.end() != conds) {
+            for (const auto &cond : conds->second) {
+                const Type &ctype = cond.data.type;
+                if ((attr.type.btype == BaseType::CHAR) != (ctype.btype == BaseType::CHAR)) throw MiniSQLException("Comparation unsupported!");
+
+                PredicateTerm term;
+                term.offset = offset;
+                term.size = attr.type.size;
+                term.int_value = 0;
+                term.float_value = 0;
+                term.column_type = attr.type.btype;
+                term.op = cond.comp;
+                term.compare_as_float = false;
+                switch (attr.type.btype) {
+                case BaseType::CHAR:
+                    term.string_value = cond.data.translate<char*>();
+                    term.kernel = selectKernel<CharColumn>(cond.comp);
+                    break;
+                case BaseType::INT:
+                    if (ctype.btype == BaseType::INT) {
+                        term.int_value = cond.data.translate<int>();
+                        term.kernel = selectKernel<IntColumn>(cond.comp);
+                    }
+                    else {
+                        term.float_value = cond.data.translate<float>();
+                        term.compare_as_float = true;
+                        term.kernel = selectKernel<IntAsFloatColumn>(cond.comp);
+                    }
+                    break;
+                case BaseType::FLOAT:
+                    term.float_value = cond.data.translate<float>();
+                    term.kernel = selectKernel<FloatColumn>(cond.comp);
+                    break;
+                }
+                if (attr.type.btype == BaseType::CHAR) char_terms.push_back(term);
+                else terms.push_back(term);
+            }
+        }
+        offset += attr.type.size;
+    }
+    numeric_count = terms.size();
+    terms.insert(terms.end(), char_terms.begin(), char_terms.end());
+
+    for (const auto &conds : pred) {
+        bool attr_exists = false;
+        for (const auto &attr : table.attrs) attr_exists = attr_exists || attr.name == conds.first;
+        if (!attr_exists) throw MiniSQLException("Invalid Attribute Identifier!");
+    }
+}
+
+int CompiledPredicate::filterPage(const char *page, size_t record_length, int count, uint64_t *selection) const {
+    int valid = selectValid(page, record_length, count, selection);
+    for (size_t i = 0; i < numeric_count; i++) {
+        const PredicateTerm &term = terms[i];
+        const char *column = page + sizeof(bool) + term.offset;
+        if (term.column_type == BaseType::INT && !term.compare_as_float) filterInt(column, record_length, count, term.op, term.int_value, selection);
+        else filterFloat(column, record_length, count, term.op, term.float_value, term.column_type == BaseType::INT, selection);
+    }
+    return valid;
+}
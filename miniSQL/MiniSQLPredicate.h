@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MiniSQLCatalogManager.h"
+#include "MiniSQLException.h"
+#include "MiniSQLSIMD.h"
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+/*                                          */
+/*                                          */
+/*              ıִ              */
+/*                                          */
+/*                                          */
+
+//һԼ¼ĳ볣һֱȽϡkernelȽϷѡֱӶ¼ԭʼֽ
+struct PredicateTerm {
+    size_t offset;//ڼ¼еƫƣvalidλ
+    size_t size;//г
+    int int_value;
+    float float_value;
+    string string_value;
+    BaseType column_type;
+    Compare op;
+    bool compare_as_float;//intfloat
+    bool (*kernel)(const char *row, const PredicateTerm &term);
+};
+
+//ÿβѯPredicateһΣɨʱ˳ִиٲValue
+class CompiledPredicate {
+public:
+    CompiledPredicate() {}
+    CompiledPredicate(const Table &table, const Predicate &pred);
+
+    bool empty() const { return terms.empty(); }
+    //rowΪ¼validλ֮
+    bool matches(const char *row) const {
+        for (const auto &term : terms) {
+            if (!term.kernel(row, term)) return false;
+        }
+        return true;
+    }
+    //һҳǰcount¼ֵvalidλΪ1ȫֵselectionλvalidλΪ1
+    int filterPage(const char *page, size_t record_length, int count, uint64_t *selection) const;
+    //filterPageѡļ¼Ƚַ
+    bool matchesRest(const char *row) const {
+        for (size_t i = numeric_count; i < terms.size(); i++) {
+            if (!terms[i].kernel(row, terms[i])) return false;
+        }
+        return true;
+    }
+private:
+    vector<PredicateTerm> terms;//ֵǰ
+    size_t numeric_count = 0;
+};
@@ -1,6 +1,14 @@
 #include "MiniSQLRecordManager.h"
+#include <exception>
 
 #define TABLE_FILE_PATH(tablename) ("../" + (tablename) + ".table")
+#define MORSEL_BLOCKS 32   //ɨÿηָһ̵߳Ŀ
+
+ThreadPool *RecordManager::getThreadPool() {
+    std::lock_guard<std::mutex> guard(pool_lock);
+    if (!pool) pool.reset(new ThreadPool((int)std::thread::hardware_concurrency()));
+    return pool.get();
+}
 
 //ļжٿ
 int RecordManager::getBlockNum(const Table &table) const {
@@ -8,194 +16,431 @@ int RecordManager::getBlockNum(const Table &table) const {
 	return table.occupied_record_count / record_per_block + 1;
 }
 
-//жϼ¼Ƿ
-bool RecordManager::isFit(const Value &v, const std::vector<Condition> &cond) const {
-	for (const auto &iter : cond) {
-        switch (iter.comp)
-        {
-        case Compare::EQ:
-            if (v != iter.data) return false;
-            break;
-        case Compare::LE:
-            if (v > iter.data) return false;
-            break;
-        case Compare::GE:
-            if (v < iter.data) return false;
-            break;
-        case Compare::NE:
-            if (v == iter.data) return false;
-            break;
-        case Compare::LT:
-            if (v >= iter.data) return false;
-            break;
-        case Compare::GT:
-            if (v <= iter.data) return false;
-            break;
-        default: throw MiniSQLException("Unsupported Comparation!");
-        }
-	}
-	return true;
-}
-
-//ɷļ¼
-Record RecordManager::addRecord(const char *const data, const Table &table) {
-	Record record;
-    const char *p = data;
-	for (const auto &attr : table.attrs) {
-		record.push_back(Value(attr.type, p));
-		p += attr.type.size;
-	}
-	return record;
+bool RecordManager::canReuseSlot(const Table &table) const {
+    return table.record_length >= sizeof(bool) + sizeof(int);
 }
 
 void RecordManager::createTable(const string &tablename) {
     string filename = TABLE_FILE_PATH(tablename);
 
-	FILE* fp;
-	fopen_s(&fp, filename.data(), "w");
-	if (fp == nullptr) throw MiniSQLException("Fail to create table file!"); //ļʧ
-	fclose(fp);
+	if (!buffer->createFile(filename)) throw MiniSQLException("Fail to create table file!"); //ļʧ
 }
 
 void RecordManager::dropTable(const string &tablename) {
     string filename = "../" + tablename + ".table";
 
-	buffer->setEmpty(filename);
-	//ļ,removeɹ0
-    if (remove(filename.data()) != 0) throw MiniSQLException("Fail to drop table file!");
+	//ļ
+    if (!buffer->removeFile(filename)) throw MiniSQLException("Fail to drop table file!");
 }
 /*
 select
 input:tablename,Table,Predicate
-output:ؼ¼ɣ
-ļͷһһbufferÿһһһ飬valid bitΪ1ļ¼бȽPredicate
-Ȼһset
+output:α꣬ȡļ¼
 */
-ReturnTable RecordManager::selectRecord(const string &tablename, const Table &table, const Predicate &pred){
-    string filename = TABLE_FILE_PATH(tablename);
+RecordCursor RecordManager::selectRecord(const string &tablename, const Table &table, const Predicate &pred, int parallelism) {
+    RecordCursor cursor(buffer, buffer->registerFile(TABLE_FILE_PATH(tablename)), table, pred);
+    if (parallelism > 1) cursor.startParallel(getThreadPool(), parallelism);
+    return cursor;
+}
 
-	int searched_record = 0;
-	int block_num = getBlockNum(table);
-    int record_length = table.record_length;
-    int record_per_block = PAGESIZE / record_length;
-	ReturnTable T;
-    for (int k = 0; k < block_num; k++) {
-        char* curRecord = buffer->getBlockContent(filename, k);//ظҳͷָ
-        while (true) {
-            if (k == block_num - 1 && searched_record == table.occupied_record_count) break;
-            char *p = curRecord;
-            if (*reinterpret_cast<bool*>(p) == true) { //valid bitΪ1
-                p++;//Ƶһ
-                //һԺpredȶ
-                bool satisfied = true;
-                for (const auto &attr : table.attrs) {
-                    string attr_name = attr.name;
-                    if (pred.end() != pred.find(attr_name)) {//ҵϵ
-                        //ȡdataбȽ
-                        Value v(attr.type, p);
-                        if (!isFit(v, pred.at(attr_name))) {//
-                            satisfied = false;
-                            break;
-                        }
-                    }
-                    p += attr.type.size;
-                }
-                if (satisfied) {//ѭ֮satisfiedΪ1 or ûwhere
-                    //set
-                    RecordInfo rec;
-                    rec.pos = { k, (searched_record % record_per_block) * record_length };
-                    rec.content = addRecord(curRecord + sizeof(bool), table);
-                    T.push_back(rec);
-                }
-            }
+RecordCursor RecordManager::selectRecord(const string &tablename, const Table &table, const Predicate &pred, const std::vector<Position> &poses) {
+    return RecordCursor(buffer, buffer->registerFile(TABLE_FILE_PATH(tablename)), table, pred, poses);
+}
 
-            curRecord += record_length;
-            if (++searched_record % record_per_block == 0) break;
+/*
+delete
+input:table_name,Table,Predicate
+output:none
+positionbufferӦdirty=trueü¼valid bitΪfalse
+ٰѸò۹ҵͷϣvalid bit֮ԭͷ
+*/
+int RecordManager::deleteRecord(const string &tablename, const Table &table, const Position &pos) {
+    int file = buffer->registerFile(TABLE_FILE_PATH(tablename));
+    PageGuard page = buffer->fetchPage(file, pos.block_id, PageIntent::WRITE);
+    *reinterpret_cast<bool*>(page.data() + pos.offset) = false;
+    if (!canReuseSlot(table)) return -1;
+
+    memcpy_s(page.data() + pos.offset + sizeof(bool), sizeof(int), &table.free_slot, sizeof(int));
+    int record_per_block = PAGESIZE / table.record_length;
+    return pos.block_id * record_per_block + pos.offset / (int)table.record_length;
+}
+/*
+insert
+input:tablename,TableһRecord
+output:¼λáĿͷ׷ļĩβ
+uniqueԵĲAPIɣֻд
+ÿϵĲۣٽļһĩβ壬valid bitΪ1
+ͬһϵļ¼ֻȡһҳ
+*/
+int RecordManager::insertRecords(const string &tablename, const Table &table, const std::vector<Record> &records, std::vector<Position> &poses, int &free_slot) {
+    int file = buffer->registerFile(TABLE_FILE_PATH(tablename));
+
+    int record_per_block = PAGESIZE / table.record_length;
+    int end_slot = table.occupied_record_count;
+    free_slot = table.free_slot;
+    PageGuard page;
+    int page_block = -1;
+    poses.clear();
+    poses.reserve(records.size());
+    for (const auto &record : records) {
+        bool reuse = free_slot != -1;
+        int slot = reuse ? free_slot : end_slot++;
+        int block = slot / record_per_block;
+        int offset = (slot % record_per_block)*table.record_length;
+        if (block != page_block) {
+            page = buffer->fetchPage(file, block, PageIntent::WRITE);
+            page_block = block;
+        }
+        if (reuse) {
+            if (*reinterpret_cast<bool*>(page.data() + offset) == true) throw MiniSQLException("Free Slot List Corrupted!");
+            memcpy_s(&free_slot, sizeof(int), page.data() + offset + sizeof(bool), sizeof(int));
+        }
+        poses.push_back({ block, offset });
+        //valid
+        *reinterpret_cast<bool*>(page.data() + offset) = true;
+        //д
+        offset += sizeof(bool);
+        for (const auto &value : record) {
+            char *data = value.translate<char*>();
+            memcpy_s(page.data() + offset, PAGESIZE - offset, data, value.type.size);
+            offset += value.type.size;
         }
     }
-	return T;
+
+    return end_slot - table.occupied_record_count;
 }
 
-ReturnTable RecordManager::selectRecord(const string &tablename, const Table &table, const Predicate &pred, const std::vector<Position> &poses) {
-    string filename = TABLE_FILE_PATH(tablename);
+void RecordManager::forEachRecord(const string &tablename, const Table &table, const std::function<void(const Position&, const char*)> &visit) {
+    int file = buffer->registerFile(TABLE_FILE_PATH(tablename));
 
+    int searched_record = 0;
+    int live_record = 0;
+    int block_num = getBlockNum(table);
     int record_length = table.record_length;
-    ReturnTable T;
-    for (auto pos : poses) {
-        char* curRecord = buffer->getBlockContent(filename, pos.block_id);//ظҳͷָ
-        curRecord += pos.offset + sizeof(bool);
-        char *p = curRecord;
-        //һԺpredȶ
-        bool satisfied = true;
-        for (const auto &attr : table.attrs) {
-            string attr_name = attr.name;
-            if (pred.end() != pred.find(attr_name)) {//ҵϵ
-                //ȡdataбȽ
-                Value v(attr.type, p);
-                if (!isFit(v, pred.at(attr_name))) {//
-                    satisfied = false;
-                    break;
-                }
+    int record_per_block = PAGESIZE / record_length;
+    for (int k = 0; k < block_num && live_record < table.live_record_count; k++) {
+        if (k % (SCAN_READ_AHEAD / 2) == 0) buffer->prefetch(file, k + 1, std::min(SCAN_READ_AHEAD, block_num - k - 1));
+        PageGuard page = buffer->fetchPage(file, k, PageIntent::READ_ONLY);
+        for (int i = 0; i < record_per_block && searched_record < table.occupied_record_count; i++, searched_record++) {
+            const char *curRecord = page.data() + i * record_length;
+            if (*reinterpret_cast<const bool*>(curRecord) == true) {
+                visit({ k, i * record_length }, curRecord + sizeof(bool));
+                if (++live_record == table.live_record_count) break;
             }
-            p += attr.type.size;
-        }
-        if (satisfied) {//ѭ֮satisfiedΪ1 or ûwhere
-            //set
-            RecordInfo rec;
-            rec.pos = pos;
-            rec.content = addRecord(curRecord, table);
-            T.push_back(rec);
         }
     }
-    return T;
 }
 
 /*
-delete
-input:table_name,Table,Predicate
-output:none
-positionbufferӦdirty=trueü¼valid bitΪfalse
+vacuum
+input:tablename,Table
+output:ļСֽ
+ȡЧ¼һҳдʱļֻռһҳڴ棻д滻ԭļ
 */
-void RecordManager::deleteRecord(const string &tablename, const Position &pos) {
+long long RecordManager::compactTable(const string &tablename, const Table &table) {
     string filename = TABLE_FILE_PATH(tablename);
-    bool valid = false;
-    buffer->setBlockContent(filename, pos.block_id, pos.offset, reinterpret_cast<char*>(&valid), sizeof(valid));
+    string tmp_filename = filename + ".vacuum";
+    int record_length = table.record_length;
+    int record_per_block = PAGESIZE / record_length;
+
+    FILE *fp;
+    if (fopen_s(&fp, tmp_filename.data(), "wb") != 0) throw MiniSQLException("Fail to create vacuum file!");
+    std::vector<char> block(PAGESIZE, 0);
+    int live_record = 0;
+    int new_blocks = 0;
+    bool ok = true;
+    try {
+        forEachRecord(tablename, table, [&](const Position &, const char *content) {
+            int i = live_record % record_per_block;
+            block[i * record_length] = true;
+            memcpy_s(block.data() + i * record_length + sizeof(bool), PAGESIZE - i * record_length - sizeof(bool), content, record_length - sizeof(bool));
+            if (++live_record % record_per_block == 0) {
+                ok = ok && fwrite(block.data(), PAGESIZE, 1, fp) == 1;
+                new_blocks++;
+                memset(block.data(), 0, PAGESIZE);
+            }
+        });
+        if (live_record % record_per_block != 0) {
+            ok = ok && fwrite(block.data(), PAGESIZE, 1, fp) == 1;
+            new_blocks++;
+        }
+        ok = syncFile(fp) && ok;//滻ǰļڴ
+    }
+    catch (...) {
+        fclose(fp);
+        remove(tmp_filename.data());
+        throw;
+    }
+    fclose(fp);
+    if (!ok) {
+        remove(tmp_filename.data());
+        throw MiniSQLException("Fail to write vacuum file!");
+    }
+
+    //¾ļʵʵĿ
+    int old_blocks = buffer->getBlockCount(buffer->registerFile(filename));
+    buffer->replaceFile(filename, tmp_filename);
+    return (long long)(old_blocks - new_blocks) * PAGESIZE;
+}
+
+/*                                          */
+/*                  α                    */
+/*                                          */
+
+Record RowView::toRecord() const {
+    Record record;
+    record.reserve(table->attrs.size());
+    for (size_t i = 0; i < table->attrs.size(); i++) record.push_back(getValue(i));
+    return record;
 }
+
+/*                                          */
+/*                 ɨ                 */
+/*                                          */
+
 /*
-insert
-input:tablename,TableRecord
-output:none
-ҪuniqueԻǷظthrow쳣
-Ȼҵļһĩβ¼valid bitΪ1
+鰴MORSEL_BLOCKSһֳmorselÿmorselΪһ񽻸̳߳أɨѷļ¼ƳͷأдӲȴαꡣ
+windowλõĻύmorselαȡߵwindowռõڴ棻ͬʱִе񲻳workers
+ɻαȡ߽ڳλʱύmorsel
 */
-Position RecordManager::insertRecord(const string &tablename, const Table &table, const Record &record) {
-    string filename = TABLE_FILE_PATH(tablename);
+struct ParallelScan : std::enable_shared_from_this<ParallelScan> {
+    ParallelScan(BufferManager *buffer, int file, const Table &table, const CompiledPredicate &filter, int window);
 
-	//ͻ
-    auto value_ptr = record.begin();
-    for (auto attr = table.attrs.begin(); attr != table.attrs.end(); attr++, value_ptr++) {
-        if (attr->unique) {
-            Predicate pred;
-            pred[attr->name].push_back({ Compare::EQ, *value_ptr });
-            ReturnTable result = selectRecord(tablename, table, pred);
-            if(result.size() > 0) throw MiniSQLException("Duplicate Value on Unique Attribute!");
+    void start(ThreadPool *pool, int workers);
+    void submitMore();//ʱlock
+    void work(int id);//ִ̳߳Уɨidmorsel
+    void scan(int id, Morsel &morsel);
+    bool take(int id, Morsel &morsel);//αȡidmorselĽȡ귵false
+    void cancel();//ύµmorselύ
+
+    BufferManager *buffer;
+    int file;
+    Table table;
+    CompiledPredicate filter;
+    int record_per_block;
+    int morsel_num;
+    int window;
+    ThreadPool *pool;
+    int workers;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    int next_morsel;//һύ
+    int consumed;//αȡߵĸ
+    int running;//ύû
+    bool cancelled;
+    std::vector<Morsel> results;
+    std::vector<bool> done;
+    std::exception_ptr error;//е쳣α׳
+};
+
+ParallelScan::ParallelScan(BufferManager *buffer, int file, const Table &table, const CompiledPredicate &filter, int window)
+    : buffer(buffer), file(file), table(table), filter(filter), window(window), pool(nullptr), workers(0)
+    , next_morsel(0), consumed(0), running(0), cancelled(false), results(window), done(window, false)
+{
+    record_per_block = PAGESIZE / table.record_length;
+    int block_num = (table.occupied_record_count + record_per_block - 1) / record_per_block;
+    morsel_num = (block_num + MORSEL_BLOCKS - 1) / MORSEL_BLOCKS;
+}
+
+void ParallelScan::start(ThreadPool *pool, int workers) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->pool = pool;
+    this->workers = workers;
+    submitMore();
+}
+
+void ParallelScan::submitMore() {
+    while (!cancelled && running < workers && next_morsel < morsel_num && next_morsel < consumed + window) {
+        int id = next_morsel++;
+        running++;
+        auto self = shared_from_this();
+        pool->submit([self, id] { self->work(id); });
+    }
+}
+
+void ParallelScan::work(int id) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (cancelled) {
+            running--;
+            changed.notify_all();
+            return;
         }
     }
-    //
-    int inserted_block_num = getBlockNum(table) - 1;
-    int record_per_block = PAGESIZE / table.record_length;
-    int offset = (table.occupied_record_count - record_per_block*inserted_block_num)*table.record_length;
-    Position pos = { inserted_block_num, offset };
-    //valid
-    bool valid = true;
-    buffer->setBlockContent(filename, inserted_block_num, offset, reinterpret_cast<char*>(&valid), sizeof(valid));
-    //д
-    offset += sizeof(valid);
-    for (const auto &value : record) {
-        char *data = value.translate<char*>();
-        buffer->setBlockContent(filename, inserted_block_num, offset, data, value.type.size);
-        offset += value.type.size;
+
+    Morsel morsel;
+    std::exception_ptr failure;
+    try { scan(id, morsel); }
+    catch (...) { failure = std::current_exception(); }
+
+    std::lock_guard<std::mutex> guard(lock);
+    running--;
+    if (failure) {
+        if (!error) error = failure;
+        cancelled = true;
+    }
+    else {
+        results[id % window] = std::move(morsel);
+        done[id % window] = true;
+        submitMore();
     }
+    changed.notify_all();
+}
+
+void ParallelScan::scan(int id, Morsel &morsel) {
+    uint64_t selection[SELECTION_WORDS];
+    size_t row_size = table.record_length - sizeof(bool);
+    int first = id * MORSEL_BLOCKS;
+    int block_num = (table.occupied_record_count + record_per_block - 1) / record_per_block;
+    buffer->prefetch(file, first + 1, std::min(MORSEL_BLOCKS - 1, block_num - first - 1));//morselһԤ
+    for (int block = first; block < first + MORSEL_BLOCKS; block++) {
+        int count = std::min(record_per_block, table.occupied_record_count - block * record_per_block);
+        if (count <= 0) break;
+        PageGuard page = buffer->fetchPage(file, block, PageIntent::READ_ONLY);
+        filter.filterPage(page.data(), table.record_length, count, selection);
+        for (int i = nextSelected(selection, 0, count); i < count; i = nextSelected(selection, i + 1, count)) {
+            const char *row = page.data() + i * table.record_length + sizeof(bool);
+            if (!filter.matchesRest(row)) continue;
+            morsel.rows.insert(morsel.rows.end(), row, row + row_size);
+            morsel.poses.push_back({ block, i * (int)table.record_length });
+        }
+    }
+}
+
+bool ParallelScan::take(int id, Morsel &morsel) {
+    if (id >= morsel_num) return false;
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&] { return done[id % window] || error; });
+    if (error) std::rethrow_exception(error);
+    morsel = std::move(results[id % window]);
+    done[id % window] = false;
+    consumed = id + 1;
+    submitMore();
+    return true;
+}
 
-    return pos;
-}
\ No newline at end of file
+void ParallelScan::cancel() {
+    std::unique_lock<std::mutex> guard(lock);
+    cancelled = true;
+    changed.wait(guard, [this] { return running == 0; });
+}
+
+/*                                          */
+/*                   α                   */
+/*                                          */
+
+RecordCursor::RecordCursor(BufferManager *buffer, int file, const Table &table, const Predicate &pred)
+    : buffer(buffer), file(file), table(table), filter(table, pred), by_position(false), next_pos(0), ahead_pos(0)
+    , block(0), slot(0), live_record(0), page_count(0), page_block(-1), morsel_row(0), morsel_id(0)
+{
+    record_per_block = PAGESIZE / table.record_length;
+    block_num = (table.occupied_record_count + record_per_block - 1) / record_per_block;
+    size_t offset = 0;
+    for (const auto &attr : table.attrs) {
+        offsets.push_back(offset);
+        offset += attr.type.size;
+    }
+}
+
+RecordCursor::RecordCursor(BufferManager *buffer, int file, const Table &table, const Predicate &pred, const std::vector<Position> &poses)
+    : RecordCursor(buffer, file, table, pred)
+{
+    by_position = true;
+    this->poses = poses;
+}
+
+RecordCursor::~RecordCursor() {
+    if (parallel) parallel->cancel();
+}
+
+//ÿ߳ٷֵһmorselֵò
+void RecordCursor::startParallel(ThreadPool *pool, int parallelism) {
+    auto scan = std::make_shared<ParallelScan>(buffer, file, table, filter, 2 * parallelism);
+    int workers = std::min(parallelism, std::min(pool->size(), scan->morsel_num));
+    if (workers < 2) return;
+    parallel = scan;
+    scan->start(pool, workers);
+}
+
+//ҪʱŻҳͬһҳϵļ¼ֻȡһҳ
+const char *RecordCursor::recordAt(int block_id, int offset) {
+    if (block_id != page_block) {
+        page = buffer->fetchPage(file, block_id, PageIntent::READ_ONLY);
+        page_block = block_id;
+    }
+    return page.data() + offset;
+}
+
+bool RecordCursor::next(RecordInfo &rec) {
+    RowView row;
+    if (!next(row, rec.pos)) return false;
+    rec.content = row.toRecord();
+    return true;
+}
+
+/*
+˳ɨ裺ÿһҳȶҳvalid bitֵõѡλͼѡеļ¼бȽַ
+Ч¼˾Ͳɨλȡȡĸλϵļ¼Ƚϡ
+ַʽÿ߹ԤھԤĿ飬ǰҳʱҳڶ
+*/
+bool RecordCursor::next(RowView &row, Position &pos) {
+    if (parallel) {
+        while (morsel_row == morsel.poses.size()) {
+            if (!parallel->take(morsel_id, morsel)) return false;
+            morsel_id++;
+            morsel_row = 0;
+        }
+        pos = morsel.poses[morsel_row];
+        row = RowView(morsel.rows.data() + morsel_row * (table.record_length - sizeof(bool)), &table, &offsets);
+        morsel_row++;
+        return true;
+    }
+    if (by_position) {
+        while (next_pos < poses.size()) {
+            if (next_pos == ahead_pos) {
+                size_t end = std::min(poses.size(), next_pos + SCAN_READ_AHEAD);
+                std::vector<int> blocks;
+                for (size_t i = next_pos; i < end; i++) {
+                    if (blocks.empty() || blocks.back() != poses[i].block_id) blocks.push_back(poses[i].block_id);
+                }
+                buffer->prefetch(file, blocks);
+                ahead_pos = next_pos + SCAN_READ_AHEAD / 2;
+            }
+            pos = poses[next_pos++];
+            const char *curRecord = recordAt(pos.block_id, pos.offset);
+            if (filter.matches(curRecord + sizeof(bool))) {
+                row = RowView(curRecord + sizeof(bool), &table, &offsets);
+                return true;
+            }
+        }
+    }
+    else {
+        while (true) {
+            if (slot == 0) {
+                int remaining = table.occupied_record_count - block * record_per_block;
+                if (remaining <= 0 || live_record >= table.live_record_count) break;
+                page_count = std::min(record_per_block, remaining);
+                if (block % (SCAN_READ_AHEAD / 2) == 0) buffer->prefetch(file, block + 1, std::min(SCAN_READ_AHEAD, block_num - block - 1));
+                live_record += filter.filterPage(recordAt(block, 0), table.record_length, page_count, selection);
+            }
+            int selected = nextSelected(selection, slot, page_count);
+            if (selected == page_count) {
+                block++;
+                slot = 0;
+                continue;
+            }
+            slot = selected + 1;
+
+            pos = { block, selected * (int)table.record_length };
+            const char *curRecord = page.data() + pos.offset;
+            if (filter.matchesRest(curRecord + sizeof(bool))) {
+                row = RowView(curRecord + sizeof(bool), &table, &offsets);
+                return true;
+            }
+        }
+    }
+    page.release();//ɨˣٶסһҳ
+    page_block = -1;
+    return false;
+}
@@ -1,31 +1,142 @@
 #pragma once
 #include "MiniSQLBufferManager.h"
 #include "MiniSQLCatalogManager.h"
+#include "MiniSQLPredicate.h"
+#include "MiniSQLThreadPool.h"
 #include "MiniSQLException.h"
 #include <vector>
 #include <set>
 #include <map>
 #include <string>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <shared_mutex>
 using namespace std;
 
+#define MAX_PARALLELISM 64   //ɨ߳
+#define SCAN_READ_AHEAD 16   //˳ɨʱԤĿλȡʱԤλ
+
+//¼ֻͼֱҳеݣơֻαͣ¼ϣҳסʱЧ
+//֮ҪþtoRecord()һ
+class RowView {
+public:
+    RowView() : data(nullptr), table(nullptr), offsets(nullptr) {}
+    RowView(const char *data, const Table *table, const std::vector<size_t> *offsets) : data(data), table(table), offsets(offsets) {}
+
+    size_t size() const { return table->attrs.size(); }
+    const Type &type(size_t i) const { return table->attrs[i].type; }
+    const char *column(size_t i) const { return data + (*offsets)[i]; }
+
+    int getInt(size_t i) const {
+        int value;
+        memcpy(&value, column(i), sizeof(int));
+        return value;
+    }
+    float getFloat(size_t i) const {
+        float value;
+        memcpy(&value, column(i), sizeof(float));
+        return value;
+    }
+    const char *getChar(size_t i) const { return column(i); }
+    Value getValue(size_t i) const { return Value(type(i), column(i)); }
+    Record toRecord() const;
+private:
+    const char *data;
+    const Table *table;
+    const std::vector<size_t> *offsets;
+};
+
+//ɨһĿ飨һmorselļ¼ݣvalidλδ
+struct Morsel {
+    std::vector<char> rows;
+    std::vector<Position> poses;
+};
+
+struct ParallelScan;
+
+//ѯα꣺ɨ赽ȡѽһԶװڴ棻
+//ǰڵҳֶסȡαʱſ
+//ɨʱ̳߳е̰߳morselͷɨ裬α갴˳ȡmorselĽ
+class RecordCursor {
+public:
+    //˳ɨȫ
+    RecordCursor(BufferManager *buffer, int file, const Table &table, const Predicate &pred);
+    //ȡλϵļ¼
+    RecordCursor(BufferManager *buffer, int file, const Table &table, const Predicate &pred, const std::vector<Position> &poses);
+    RecordCursor(RecordCursor &&) = default;
+    RecordCursor(const RecordCursor &) = delete;
+    ~RecordCursor();
+
+    //Ϊparallelism̲߳ɨ裬ȡһ֮ǰ
+    void startParallel(ThreadPool *pool, int parallelism);
+    //αڼһֱѶ
+    void holdLock(std::shared_lock<std::shared_timed_mutex> &&lock) { locks.push_back(std::move(lock)); }
+
+    //ȡһļ¼û˷falseͼһεǰЧ
+    bool next(RowView &row, Position &pos);
+    //ͬϣƳ¼
+    bool next(RecordInfo &rec);
+    const Table &getTable() const { return table; }
+private:
+    const char *recordAt(int block_id, int offset);
+
+    std::vector<std::shared_lock<std::shared_timed_mutex>> locks;//ԱſŽ
+    BufferManager *buffer;
+    int file;
+    Table table;//ʱıϢ֮Ĳ벻Ӱ챾ɨķΧ
+    std::vector<size_t> offsets;//ڼ¼еƫƣvalidλ
+    CompiledPredicate filter;
+
+    bool by_position;
+    std::vector<Position> poses;
+    size_t next_pos;
+    size_t ahead_pos;//λʱԤһ
+
+    int record_per_block;
+    int block_num;
+    int block, slot;//˳ɨһλ
+    int live_record;
+    int page_count;//ǰҳϵļ¼
+    uint64_t selection[SELECTION_WORDS];//ǰҳҳ˵Ľ
+
+    PageGuard page;
+    int page_block;
+
+    std::shared_ptr<ParallelScan> parallel;//ύҲУαûʼ԰ȫ˳
+    Morsel morsel;//ȡmorsel
+    size_t morsel_row;
+    int morsel_id;
+};
+
 class RecordManager {
 public:
     RecordManager(BufferManager *buffer) : buffer(buffer) {}
+    RecordManager(const RecordManager &) = delete;
 
 	void createTable(const string &tablename);
 	void dropTable(const string &tablename);
-	ReturnTable selectRecord(const string &tablename, const Table &table, const Predicate &pred);
-    ReturnTable selectRecord(const string &tablename, const Table &table, const Predicate &pred, const std::vector<Position> &poses);
-	void deleteRecord(const string &tablename, const Position &pos);
-	Position insertRecord(const string &tablename, const Table &table, const Record &record);
+	//parallelism1ʱɨ裬԰¼ļе˳
+	RecordCursor selectRecord(const string &tablename, const Table &table, const Predicate &pred, int parallelism = 1);
+    RecordCursor selectRecord(const string &tablename, const Table &table, const Predicate &pred, const std::vector<Position> &poses);
+	//رɾ¼Ĳۺţѹҵϣ¼̷̫Ųָʱ-1
+	int deleteRecord(const string &tablename, const Table &table, const Position &pos);
+	//ȸÿвۣposesظ¼λãfree_slotزĿͷֵΪ׷ļĩβ
+	int insertRecords(const string &tablename, const Table &table, const std::vector<Record> &records, std::vector<Position> &poses, int &free_slot);
+    //ηʱÿЧ¼visit(λ, ¼ݣvalidλ֮)
+    void forEachRecord(const string &tablename, const Table &table, const std::function<void(const Position&, const char*)> &visit);
+    //Ч¼ԭ˳յдļ滻ԭļСֽ
+    long long compactTable(const string &tablename, const Table &table);
 private:
 	//ļжٿ
 	int getBlockNum(const Table &table) const;
-	//жϼ¼Ƿ
-	bool isFit(const Value &v, const std::vector<Condition> &cond) const;
-	//ɷļ¼
-	Record addRecord(const char *const data, const Table &table);
+	//ɾĲvalidλ֮һвۺţ¼ŵ
+	bool canReuseSlot(const Table &table) const;
 	
-	BufferManager *buffer;
+	//һβɨʱŴ̳߳أ߳ΪCPU
+	ThreadPool *getThreadPool();
 
+	BufferManager *buffer;
+	std::unique_ptr<ThreadPool> pool;
+	std::mutex pool_lock;
 };
@@ -0,0 +1,72 @@
+#include "MiniSQLReplacer.h"
+
+Replacer *Replacer::create(ReplacePolicy policy, int page_num) {
+    switch (policy) {
+    case ReplacePolicy::LRU_2:    return new LRU2Replacer(page_num);
+    case ReplacePolicy::CLOCK:
+    default:    return new ClockReplacer(page_num);
+    }
+}
+
+//ʱָתȦҲ˵ҳס
+int ClockReplacer::victim(const std::function<bool(int)> &evictable) {
+    int page_num = (int)ref.size();
+    for (int step = 0; step < 2 * page_num; step++) {
+        int page_id = hand;
+        hand = (hand + 1) % page_num;
+        if (!evictable(page_id)) continue;
+        if (ref[page_id]) ref[page_id] = false;
+        else return page_id;
+    }
+    return -1;
+}
+
+//ָǰδǵҳȱתһȦҳ
+void ClockReplacer::candidates(int count, vector<int> &pages) const {
+    int page_num = (int)ref.size();
+    for (int pass = 0; pass < 2; pass++) {
+        for (int step = 0; step < page_num && (int)pages.size() < count; step++) {
+            int page_id = (hand + step) % page_num;
+            if (ref[page_id] == (pass == 1)) pages.push_back(page_id);
+        }
+    }
+}
+
+void LRU2Replacer::recordLoad(int page_id) {
+    remove(page_id);
+    last[page_id] = ++now;
+    prev[page_id] = 0;
+    order.insert(Entry(prev[page_id], last[page_id], page_id));
+}
+
+void LRU2Replacer::recordAccess(int page_id) {
+    if (last[page_id] == 0) return;//滻
+    order.erase(Entry(prev[page_id], last[page_id], page_id));
+    if (last[page_id] != now) prev[page_id] = last[page_id];//һηʲµһη
+    last[page_id] = ++now;
+    order.insert(Entry(prev[page_id], last[page_id], page_id));
+}
+
+void LRU2Replacer::remove(int page_id) {
+    if (last[page_id] == 0) return;
+    order.erase(Entry(prev[page_id], last[page_id], page_id));
+    last[page_id] = prev[page_id] = 0;
+}
+
+int LRU2Replacer::victim(const std::function<bool(int)> &evictable) {
+    for (const auto &entry : order) {
+        int page_id = std::get<2>(entry);
+        if (evictable(page_id)) {
+            remove(page_id);
+            return page_id;
+        }
+    }
+    return -1;
+}
+
+void LRU2Replacer::candidates(int count, vector<int> &pages) const {
+    for (const auto &entry : order) {
+        if ((int)pages.size() >= count) break;
+        pages.push_back(std::get<2>(entry));
+    }
+}
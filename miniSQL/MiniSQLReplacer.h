@@ -0,0 +1,79 @@
+#pragma once
+
+#include <set>
+#include <tuple>
+#include <vector>
+#include <functional>
+using std::vector;
+
+//ҳ滻
+enum class ReplacePolicy {
+    CLOCK = 0, LRU_2
+};
+
+/*                                          */
+/*                                          */
+/*              滻Խӿ                */
+/*                                          */
+/*                                          */
+
+class Replacer {
+public:
+    virtual ~Replacer() = default;
+
+    //ҳװ飨δУ
+    virtual void recordLoad(int page_id) = 0;
+    //ҳٴηʣУ
+    virtual void recordAccess(int page_id) = 0;
+    //ҳգٲ滻
+    virtual void remove(int page_id) = 0;
+    //ѡһ滻ҳƳ滻Уȫ滻ʱ-1
+    virtual int victim(const std::function<bool(int)> &evictable) = 0;
+    //Ⱥcountҳı滻״̨̬дǰдأ
+    virtual void candidates(int count, vector<int> &pages) const = 0;
+
+    static Replacer *create(ReplacePolicy policy, int page_num);
+};
+
+/*                                          */
+/*                 ʱ滻                 */
+/*                                          */
+
+class ClockReplacer : public Replacer {
+public:
+    ClockReplacer(int page_num) : ref(page_num, false), hand(0) {}
+
+    void recordLoad(int page_id) override { ref[page_id] = true; }
+    void recordAccess(int page_id) override { ref[page_id] = true; }
+    void remove(int page_id) override { ref[page_id] = false; }
+    int victim(const std::function<bool(int)> &evictable) override;
+    void candidates(int count, vector<int> &pages) const override;
+private:
+    vector<bool> ref;//ʹñ
+    int hand;//ʱָ
+};
+
+/*                                          */
+/*           LRU-2滻ɨ裩            */
+/*                                          */
+
+//ڶηʵʱֻ̭ʹһεҳȫɨҳȱ
+//ʵҳB+ڲ㣩ᱻһɨ輷
+//ŶͬһҳΪͬһηʣһβеĶζдҳΪҳ
+class LRU2Replacer : public Replacer {
+public:
+    LRU2Replacer(int page_num) : last(page_num, 0), prev(page_num, 0), now(0) {}
+
+    void recordLoad(int page_id) override;
+    void recordAccess(int page_id) override;
+    void remove(int page_id) override;
+    int victim(const std::function<bool(int)> &evictable) override;
+    void candidates(int count, vector<int> &pages) const override;
+private:
+    using Entry = std::tuple<long long, long long, int>;//(ڶη, һη, ҳ)
+
+    vector<long long> last;//һηʱ
+    vector<long long> prev;//ڶηʱ䣬0ʾֻʹһ
+    std::set<Entry> order;//̭Ⱥ
+    long long now;//߼ʱ
+};
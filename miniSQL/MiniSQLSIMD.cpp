@@ -0,0 +1,327 @@
+#include "MiniSQLSIMD.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MINISQL_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#else
+#include <immintrin.h>
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+template<typename T>
+inline bool test(Compare op, T lhs, T rhs) {
+    switch (op) {
+    case Compare::EQ:    return lhs == rhs;
+    case Compare::NE:    return lhs != rhs;
+    case Compare::LT:    return lhs < rhs;
+    case Compare::LE:    return lhs <= rhs;
+    case Compare::GT:    return lhs > rhs;
+    case Compare::GE:    return lhs >= rhs;
+    }
+    return false;
+}
+
+inline int loadInt(const char *p) {
+    int value;
+    memcpy(&value, p, sizeof(int));
+    return value;
+}
+
+inline float loadFloat(const char *p) {
+    float value;
+    memcpy(&value, p, sizeof(float));
+    return value;
+}
+
+inline bool isSelected(const uint64_t *selection, int i) { return (selection[i >> 6] >> (i & 63)) & 1; }
+inline void unselect(uint64_t *selection, int i) { selection[i >> 6] &= ~(1ULL << (i & 63)); }
+
+/*                                          */
+/*                 Ƚ                 */
+/*                                          */
+
+//ӵstartʼSIMDʵʣµβ
+int selectValidScalar(const char *page, size_t stride, int start, int count, uint64_t *selection) {
+    int valid = 0;
+    for (int i = start; i < count; i++) {
+        if (page[i * stride] != 0) {
+            selection[i >> 6] |= 1ULL << (i & 63);
+            valid++;
+        }
+    }
+    return valid;
+}
+
+void filterIntScalar(const char *column, size_t stride, int start, int count, Compare op, int value, uint64_t *selection) {
+    for (int i = start; i < count; i++) {
+        if (isSelected(selection, i) && !test(op, loadInt(column + i * stride), value)) unselect(selection, i);
+    }
+}
+
+void filterFloatScalar(const char *column, size_t stride, int start, int count, Compare op, float value, bool int_column, uint64_t *selection) {
+    for (int i = start; i < count; i++) {
+        if (!isSelected(selection, i)) continue;
+        const char *p = column + i * stride;
+        float lhs = int_column ? (float)loadInt(p) : loadFloat(p);
+        if (!test(op, lhs, value)) unselect(selection, i);
+    }
+}
+
+#ifdef MINISQL_X86
+
+SimdLevel detectSimdLevel() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return SimdLevel::SSE2;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return SimdLevel::SSE2;//ϵͳ뱣ymmĴ
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+    return SimdLevel::SCALAR;
+#endif
+}
+
+int popcount8(unsigned mask) {
+    int n = 0;
+    for (; mask != 0; mask &= mask - 1) n++;
+    return n;
+}
+
+/*                                          */
+/*          SSE2ÿ4װ         */
+/*                                          */
+
+SIMD_TARGET_SSE2 inline __m128i compareSSE2(Compare op, __m128i lhs, __m128i rhs) {
+    const __m128i ones = _mm_set1_epi32(-1);
+    switch (op) {
+    case Compare::EQ:    return _mm_cmpeq_epi32(lhs, rhs);
+    case Compare::NE:    return _mm_xor_si128(_mm_cmpeq_epi32(lhs, rhs), ones);
+    case Compare::LT:    return _mm_cmplt_epi32(lhs, rhs);
+    case Compare::LE:    return _mm_xor_si128(_mm_cmpgt_epi32(lhs, rhs), ones);
+    case Compare::GT:    return _mm_cmpgt_epi32(lhs, rhs);
+    case Compare::GE:    return _mm_xor_si128(_mm_cmplt_epi32(lhs, rhs), ones);
+    }
+    return _mm_setzero_si128();
+}
+
+SIMD_TARGET_SSE2 inline __m128 compareSSE2(Compare op, __m128 lhs, __m128 rhs) {
+    switch (op) {
+    case Compare::EQ:    return _mm_cmpeq_ps(lhs, rhs);
+    case Compare::NE:    return _mm_cmpneq_ps(lhs, rhs);
+    case Compare::LT:    return _mm_cmplt_ps(lhs, rhs);
+    case Compare::LE:    return _mm_cmple_ps(lhs, rhs);
+    case Compare::GT:    return _mm_cmpgt_ps(lhs, rhs);
+    case Compare::GE:    return _mm_cmpge_ps(lhs, rhs);
+    }
+    return _mm_setzero_ps();
+}
+
+SIMD_TARGET_SSE2 inline __m128i loadIntSSE2(const char *p, size_t stride) {
+    return _mm_setr_epi32(loadInt(p), loadInt(p + stride), loadInt(p + 2 * stride), loadInt(p + 3 * stride));
+}
+
+SIMD_TARGET_SSE2 inline __m128 loadFloatSSE2(const char *p, size_t stride, bool int_column) {
+    if (int_column) return _mm_cvtepi32_ps(loadIntSSE2(p, stride));
+    return _mm_setr_ps(loadFloat(p), loadFloat(p + stride), loadFloat(p + 2 * stride), loadFloat(p + 3 * stride));
+}
+
+//ÿ8Ӧѡλͼһֽڣشڼ
+SIMD_TARGET_SSE2 int filterIntSSE2(const char *column, size_t stride, int count, Compare op, int value, uint64_t *selection) {
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(selection);
+    const __m128i constant = _mm_set1_epi32(value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t &mask = bytes[i >> 3];
+        if (mask == 0) continue;//8ȫų
+        const char *p = column + i * stride;
+        int low = _mm_movemask_ps(_mm_castsi128_ps(compareSSE2(op, loadIntSSE2(p, stride), constant)));
+        int high = _mm_movemask_ps(_mm_castsi128_ps(compareSSE2(op, loadIntSSE2(p + 4 * stride, stride), constant)));
+        mask &= (uint8_t)(low | (high << 4));
+    }
+    return i;
+}
+
+SIMD_TARGET_SSE2 int filterFloatSSE2(const char *column, size_t stride, int count, Compare op, float value, bool int_column, uint64_t *selection) {
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(selection);
+    const __m128 constant = _mm_set1_ps(value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t &mask = bytes[i >> 3];
+        if (mask == 0) continue;
+        const char *p = column + i * stride;
+        int low = _mm_movemask_ps(compareSSE2(op, loadFloatSSE2(p, stride, int_column), constant));
+        int high = _mm_movemask_ps(compareSSE2(op, loadFloatSSE2(p + 4 * stride, stride, int_column), constant));
+        mask &= (uint8_t)(low | (high << 4));
+    }
+    return i;
+}
+
+/*                                          */
+/*          AVX2ÿ8gatherװ       */
+/*                                          */
+
+SIMD_TARGET_AVX2 inline __m256i compareAVX2(Compare op, __m256i lhs, __m256i rhs) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    switch (op) {
+    case Compare::EQ:    return _mm256_cmpeq_epi32(lhs, rhs);
+    case Compare::NE:    return _mm256_xor_si256(_mm256_cmpeq_epi32(lhs, rhs), ones);
+    case Compare::LT:    return _mm256_cmpgt_epi32(rhs, lhs);
+    case Compare::LE:    return _mm256_xor_si256(_mm256_cmpgt_epi32(lhs, rhs), ones);
+    case Compare::GT:    return _mm256_cmpgt_epi32(lhs, rhs);
+    case Compare::GE:    return _mm256_xor_si256(_mm256_cmpgt_epi32(rhs, lhs), ones);
+    }
+    return _mm256_setzero_si256();
+}
+
+//C++ıȽһ£NaNʱֻ!=
+SIMD_TARGET_AVX2 inline __m256 compareAVX2(Compare op, __m256 lhs, __m256 rhs) {
+    switch (op) {
+    case Compare::EQ:    return _mm256_cmp_ps(lhs, rhs, _CMP_EQ_OQ);
+    case Compare::NE:    return _mm256_cmp_ps(lhs, rhs, _CMP_NEQ_UQ);
+    case Compare::LT:    return _mm256_cmp_ps(lhs, rhs, _CMP_LT_OQ);
+    case Compare::LE:    return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OQ);
+    case Compare::GT:    return _mm256_cmp_ps(lhs, rhs, _CMP_GT_OQ);
+    case Compare::GE:    return _mm256_cmp_ps(lhs, rhs, _CMP_GE_OQ);
+    }
+    return _mm256_setzero_ps();
+}
+
+//8¼ͬһλԵ0ֽƫ
+SIMD_TARGET_AVX2 inline __m256i strideIndex(size_t stride) {
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+}
+
+//gatherһζ4ֽڣvalidλ治4ֽڵȽϣҳ
+SIMD_TARGET_AVX2 int selectValidAVX2(const char *page, size_t stride, int count, uint64_t *selection, int &valid) {
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(selection);
+    const __m256i index = strideIndex(stride);
+    const __m256i low_byte = _mm256_set1_epi32(0xFF);
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count && (i + 7) * stride + sizeof(int) <= count * stride; i += 8) {
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(page + i * stride), index, 1);
+        __m256i invalid = _mm256_cmpeq_epi32(_mm256_and_si256(v, low_byte), zero);
+        unsigned mask = ~(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(invalid)) & 0xFF;
+        bytes[i >> 3] = (uint8_t)mask;
+        valid += popcount8(mask);
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 int filterIntAVX2(const char *column, size_t stride, int count, Compare op, int value, uint64_t *selection) {
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(selection);
+    const __m256i index = strideIndex(stride);
+    const __m256i constant = _mm256_set1_epi32(value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t &mask = bytes[i >> 3];
+        if (mask == 0) continue;
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(column + i * stride), index, 1);
+        mask &= (uint8_t)_mm256_movemask_ps(_mm256_castsi256_ps(compareAVX2(op, v, constant)));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 int filterFloatAVX2(const char *column, size_t stride, int count, Compare op, float value, bool int_column, uint64_t *selection) {
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(selection);
+    const __m256i index = strideIndex(stride);
+    const __m256 constant = _mm256_set1_ps(value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t &mask = bytes[i >> 3];
+        if (mask == 0) continue;
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(column + i * stride), index, 1);
+        __m256 lhs = int_column ? _mm256_cvtepi32_ps(v) : _mm256_castsi256_ps(v);
+        mask &= (uint8_t)_mm256_movemask_ps(compareAVX2(op, lhs, constant));
+    }
+    return i;
+}
+
+#else
+
+SimdLevel detectSimdLevel() { return SimdLevel::SCALAR; }
+
+#endif
+
+SimdLevel &currentLevel() {
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+}
+
+SimdLevel getSimdLevel() {
+    return currentLevel();
+}
+
+void setSimdLevel(SimdLevel level) {
+    if (level < currentLevel()) currentLevel() = level;
+}
+
+int selectValid(const char *page, size_t stride, int count, uint64_t *selection) {
+    memset(selection, 0, ((count + 63) >> 6) * sizeof(uint64_t));
+    int valid = 0, done = 0;
+#ifdef MINISQL_X86
+    if (getSimdLevel() == SimdLevel::AVX2) done = selectValidAVX2(page, stride, count, selection, valid);
+#endif
+    return valid + selectValidScalar(page, stride, done, count, selection);
+}
+
+void filterInt(const char *column, size_t stride, int count, Compare op, int value, uint64_t *selection) {
+    int done = 0;
+#ifdef MINISQL_X86
+    switch (getSimdLevel()) {
+    case SimdLevel::AVX2:    done = filterIntAVX2(column, stride, count, op, value, selection); break;
+    case SimdLevel::SSE2:    done = filterIntSSE2(column, stride, count, op, value, selection); break;
+    default: break;
+    }
+#endif
+    filterIntScalar(column, stride, done, count, op, value, selection);
+}
+
+void filterFloat(const char *column, size_t stride, int count, Compare op, float value, bool int_column, uint64_t *selection) {
+    int done = 0;
+#ifdef MINISQL_X86
+    switch (getSimdLevel()) {
+    case SimdLevel::AVX2:    done = filterFloatAVX2(column, stride, count, op, value, int_column, selection); break;
+    case SimdLevel::SSE2:    done = filterFloatSSE2(column, stride, count, op, value, int_column, selection); break;
+    default: break;
+    }
+#endif
+    filterFloatScalar(column, stride, done, count, op, value, int_column, selection);
+}
+
+int nextSelected(const uint64_t *selection, int from, int count) {
+    for (int word = from >> 6; (word << 6) < count; word++) {
+        uint64_t bits = selection[word];
+        if (word == (from >> 6)) bits &= ~0ULL << (from & 63);
+        if (bits == 0) continue;
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long bit;
+        _BitScanForward64(&bit, bits);
+        return (word << 6) + (int)bit;
+#elif defined(__GNUC__)
+        return (word << 6) + __builtin_ctzll(bits);
+#else
+        int bit = 0;
+        while (((bits >> bit) & 1) == 0) bit++;
+        return (word << 6) + bit;
+#endif
+    }
+    return count;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "MiniSQLMeta.h"
+#include "MiniSQLBufferManager.h"
+#include <cstdint>
+
+#define MAX_RECORD_PER_PAGE (PAGESIZE / 2)   //¼validλ1ֽڵ
+#define SELECTION_WORDS (MAX_RECORD_PER_PAGE / 64)
+
+/*                                          */
+/*                                          */
+/*            ҳĹkernel          */
+/*                                          */
+/*                                          */
+
+//һҳļ¼ͬһҳڰrecord_lengthȾСkernelһҳǰcount¼Ƚϣ
+//ѡλͼi¼Ӧselection[i / 64]ĵi % 64λCPU֧ѡAVX2/SSE2ʵ֣֧ʱȽ
+
+enum class SimdLevel {
+    SCALAR, SSE2, AVX2
+};
+
+//ʱһΣsetֻܽڶԱȸʵ
+SimdLevel getSimdLevel();
+void setSimdLevel(SimdLevel level);
+
+//validλλЧ¼pageָҳףstrideΪ¼
+int selectValid(const char *page, size_t stride, int count, uint64_t *selection);
+//columnָ0¼ĸУλļ¼в㡰 op value
+void filterInt(const char *column, size_t stride, int count, Compare op, int value, uint64_t *selection);
+//int_columnʾΪintתfloatٱ
+void filterFloat(const char *column, size_t stride, int count, Compare op, float value, bool int_column, uint64_t *selection);
+//fromԺһѡеļ¼ûзcount
+int nextSelected(const uint64_t *selection, int from, int count);
@@ -0,0 +1,177 @@
+#include "MiniSQLServer.h"
+#include "MiniSQLInterpreter.h"
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#define INVALID_SOCKET_HANDLE ((SocketHandle)INVALID_SOCKET)
+#define SEND_FLAGS 0
+#define SHUTDOWN_BOTH SD_BOTH
+#define closeSocket(sock) closesocket((SOCKET)(sock))
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define INVALID_SOCKET_HANDLE (-1)
+#define SEND_FLAGS MSG_NOSIGNAL   //ԷѶϿʱش󣬲SIGPIPE
+#define SHUTDOWN_BOTH SHUT_RDWR
+#define closeSocket(sock) close(sock)
+#endif
+
+SocketStreamBuf::SocketStreamBuf(SocketHandle sock) : sock(sock) {
+    setg(input, input, input);
+    setp(output, output + SOCKET_BUFFER_SIZE);
+}
+
+//ȡٴ׽գԷϿʱEOF
+SocketStreamBuf::int_type SocketStreamBuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    int received = recv(sock, input, SOCKET_BUFFER_SIZE, 0);
+    if (received <= 0) return traits_type::eof();
+    setg(input, input, input + received);
+    return traits_type::to_int_type(*gptr());
+}
+
+SocketStreamBuf::int_type SocketStreamBuf::overflow(int_type ch) {
+    if (!flushOutput()) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int SocketStreamBuf::sync() {
+    return flushOutput() ? 0 : -1;
+}
+
+bool SocketStreamBuf::flushOutput() {
+    const char *data = pbase();
+    int length = (int)(pptr() - pbase());
+    while (length > 0) {
+        int sent = send(sock, data, length, SEND_FLAGS);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    setp(output, output + SOCKET_BUFFER_SIZE);
+    return true;
+}
+
+//ַֻ
+Server::Server(API *core, int port) : core(core), stopping(false) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw MiniSQLException("Fail to initialize socket!");
+#endif
+    listener = (SocketHandle)socket(AF_INET, SOCK_STREAM, 0);
+    if (INVALID_SOCKET_HANDLE == listener) throw MiniSQLException("Fail to create socket!");
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        closeSocket(listener);
+        throw MiniSQLException("Fail to listen on port " + std::to_string(port) + "!");
+    }
+}
+
+Server::~Server() {
+    stop();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void Server::start() {
+    acceptor = std::thread(&Server::accept, this);
+}
+
+//رռ׽acceptأϿỰӣỰEOF
+void Server::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) return;
+        stopping = true;
+        shutdown(listener, SHUTDOWN_BOTH);
+        closeSocket(listener);
+        for (SocketHandle client : clients) shutdown(client, SHUTDOWN_BOTH);
+    }
+    if (acceptor.joinable()) acceptor.join();
+    for (auto &session : sessions) session.join();
+}
+
+void Server::accept() {
+    while (true) {
+        SocketHandle client = (SocketHandle)::accept(listener, nullptr, nullptr);
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) {
+            if (INVALID_SOCKET_HANDLE != client) closeSocket(client);
+            return;
+        }
+        if (INVALID_SOCKET_HANDLE == client) continue;
+        reapSessions();
+        clients.push_back(client);
+        sessions.emplace_back(&Server::serve, this, client);
+    }
+}
+
+//ÿỰԼInterpreterжȵã
+void Server::serve(SocketHandle client) {
+    {
+        SocketStreamBuf buffer(client);
+        std::istream in(&buffer);
+        std::ostream out(&buffer);
+        in.tie(&out);//һǰȰʾȷȥ
+        try {
+            Interpreter session(core, in, out);
+            session.start();
+        }
+        catch (...) {}//ӶϿȣỰ
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    clients.erase(std::find(clients.begin(), clients.end(), client));
+    closeSocket(client);
+    finished.push_back(std::this_thread::get_id());
+}
+
+//ѽĻỰ̷߳ŵlock˳joinֻ
+void Server::reapSessions() {
+    for (auto id : finished) {
+        auto session = std::find_if(sessions.begin(), sessions.end(), [id](const std::thread &t) { return t.get_id() == id; });
+        session->join();
+        sessions.erase(session);
+    }
+    finished.clear();
+}
+
+void Server_start(size_t pool_size, ReplacePolicy policy, int port, const FlushConfig &config, bool mapped_reads) {
+    LogManager LM;
+    BufferManager BM(pool_size, policy, &LM);
+    CatalogManager CM(META_TABLE_FILE_PATH, META_INDEX_FILE_PATH);
+    LM.recover(&CM);
+    RecordManager RM(&BM);
+    IndexManager IM(&BM);
+    API core(&CM, &RM, &IM, &BM, &LM);
+    if (mapped_reads) BM.enableMappedReads();
+    BM.startWriter(config.writer_rate);
+    core.startCheckpointer(config);
+
+    Server server(&core, port);
+    server.start();
+    cout << "MiniSQL Server Listening on 127.0.0.1:" << port << ", Enter \"quit\" to Stop." << endl;
+    string line;
+    while (getline(cin, line)) {
+        if (trim(line) == "quit" || line == "quit;") break;
+    }
+    server.stop();
+    core.checkpoint();
+    cout << "Server Stopped. Buffer Hits: " << BM.getHitCount() << ", Misses: " << BM.getMissCount() << endl;
+}
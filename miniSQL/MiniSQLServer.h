@@ -0,0 +1,64 @@
+#pragma once
+
+#include "MiniSQLAPI.h"
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+
+#define SOCKET_BUFFER_SIZE 4096
+
+#ifdef _WIN32
+typedef uintptr_t SocketHandle;//SOCKET
+#else
+typedef int SocketHandle;//׽
+#endif
+
+/*                                          */
+/*                                          */
+/*                 ģʽ                 */
+/*                                          */
+/*                                          */
+
+//׽ϵ壬ỰInterpreteristream/ostreamд
+class SocketStreamBuf : public std::streambuf {
+public:
+    SocketStreamBuf(SocketHandle sock);
+    ~SocketStreamBuf() { sync(); }
+protected:
+    int_type underflow() override;
+    int_type overflow(int_type ch) override;
+    int sync() override;
+private:
+    bool flushOutput();
+
+    SocketHandle sock;
+    char input[SOCKET_BUFFER_SIZE];
+    char output[SOCKET_BUFFER_SIZE];
+};
+
+//ڱ˿ϽӣÿһỰһ߳InterpreterỰͬһAPI
+class Server {
+public:
+    Server(API *core, int port);
+    Server(const Server &) = delete;
+    ~Server();
+
+    void start();//ʼں̨
+    void stop();//ٽӣϿỰǽ
+private:
+    void accept();
+    void serve(SocketHandle client);
+    void reapSessions();//ʱlock
+
+    API *core;
+    SocketHandle listener;
+    std::thread acceptor;
+    std::mutex lock;
+    bool stopping;
+    std::vector<std::thread> sessions;
+    std::vector<std::thread::id> finished;//ѽûjoinĻỰ
+    std::vector<SocketHandle> clients;//ŵĻỰ
+};
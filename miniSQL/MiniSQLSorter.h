@@ -0,0 +1,139 @@
+#pragma once
+
+#include "MiniSQLException.h"
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+using std::string;
+using std::vector;
+
+#define DEFAULT_SORT_MEMORY (64 << 20)   //ⲿĬռ64MBڴ
+
+/*                                          */
+/*                                          */
+/*                ⲿ                  */
+/*                                          */
+/*                                          */
+
+//(,ֵ)ڴһź򣬳ڴ޾дһʱļ˳
+//ȫԸ˳·鲢СȡֵԭдΪ
+template<typename KeyType, typename DataType>
+class ExternalSorter {
+public:
+    ExternalSorter(const string &prefix, size_t memory_limit = DEFAULT_SORT_MEMORY);
+    ExternalSorter(const ExternalSorter &) = delete;
+    ~ExternalSorter();
+
+    void add(const KeyType &key, const DataType &data);
+    //ϣ׼ȡ
+    void finish();
+    //ȡһȡ귵false
+    bool next(KeyType &key, DataType &data);
+    size_t size() const { return count; }
+
+private:
+    struct Entry {
+        KeyType key;
+        DataType data;
+    };
+    struct Run {
+        FILE *fp;
+        Entry head;//˳ǰĵһ
+    };
+
+    void spill();//ڴһд˳
+    static bool lessThan(const Entry &lhs, const Entry &rhs) { return lhs.key < rhs.key; }
+
+    string prefix;//ʱļǰ׺
+    size_t capacity;//ڴܶٸ
+    size_t count;
+    vector<Entry> entries;
+    size_t cursor;//û˳ʱֱӴentriesﰴȡ
+    vector<string> runFiles;
+    vector<Run> runs;
+    std::priority_queue<int, vector<int>, std::function<bool(int, int)>> heap;//˳ǰļţѶС
+};
+
+/*                                          */
+/*                  ʵ                    */
+/*                                          */
+
+template<typename KeyType, typename DataType>
+ExternalSorter<KeyType, DataType>::ExternalSorter(const string &prefix, size_t memory_limit)
+    : prefix(prefix), count(0), cursor(0)
+    , heap([this](int lhs, int rhs) { return lessThan(runs[rhs].head, runs[lhs].head); })
+{
+    capacity = memory_limit / sizeof(Entry);
+    if (capacity < 1) capacity = 1;
+}
+
+template<typename KeyType, typename DataType>
+ExternalSorter<KeyType, DataType>::~ExternalSorter() {
+    for (auto &run : runs) {
+        if (run.fp != nullptr) fclose(run.fp);
+    }
+    for (const auto &filename : runFiles) remove(filename.data());
+}
+
+template<typename KeyType, typename DataType>
+void ExternalSorter<KeyType, DataType>::add(const KeyType &key, const DataType &data) {
+    entries.push_back(Entry{ key, data });
+    count++;
+    if (entries.size() >= capacity) spill();
+}
+
+template<typename KeyType, typename DataType>
+void ExternalSorter<KeyType, DataType>::spill() {
+    std::sort(entries.begin(), entries.end(), lessThan);
+
+    string filename = prefix + ".run" + std::to_string(runFiles.size());
+    FILE *fp;
+    if (fopen_s(&fp, filename.data(), "wb") != 0) throw MiniSQLException("Fail to create sort file!");
+    runFiles.push_back(filename);
+    size_t written = fwrite(entries.data(), sizeof(Entry), entries.size(), fp);
+    fclose(fp);
+    if (written != entries.size()) throw MiniSQLException("Fail to write sort file!");
+    entries.clear();
+}
+
+template<typename KeyType, typename DataType>
+void ExternalSorter<KeyType, DataType>::finish() {
+    if (runFiles.empty()) {//ȫڴ
+        std::sort(entries.begin(), entries.end(), lessThan);
+        cursor = 0;
+        return;
+    }
+
+    if (!entries.empty()) spill();
+    vector<Entry>().swap(entries);
+    for (const auto &filename : runFiles) {
+        Run run = Run();
+        if (fopen_s(&run.fp, filename.data(), "rb") != 0) throw MiniSQLException("Fail to open sort file!");
+        runs.push_back(run);
+    }
+    for (int i = 0; i < (int)runs.size(); i++) {
+        if (fread(&runs[i].head, sizeof(Entry), 1, runs[i].fp) == 1) heap.push(i);
+    }
+}
+
+template<typename KeyType, typename DataType>
+bool ExternalSorter<KeyType, DataType>::next(KeyType &key, DataType &data) {
+    if (runs.empty()) {
+        if (cursor >= entries.size()) return false;
+        key = entries[cursor].key;
+        data = entries[cursor].data;
+        cursor++;
+        return true;
+    }
+
+    if (heap.empty()) return false;
+    int i = heap.top();
+    heap.pop();
+    key = runs[i].head.key;
+    data = runs[i].head.data;
+    if (fread(&runs[i].head, sizeof(Entry), 1, runs[i].fp) == 1) heap.push(i);
+    return true;
+}
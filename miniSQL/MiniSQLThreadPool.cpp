@@ -0,0 +1,38 @@
+#include "MiniSQLThreadPool.h"
+
+ThreadPool::ThreadPool(int thread_num) : stopping(false) {
+    if (thread_num < 1) thread_num = 1;
+    for (int i = 0; i < thread_num; i++) workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push(std::move(task));
+    }
+    ready.notify_one();
+}
+
+//Լ쳣쳣ܳ߳
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*                                          */
+/*                                          */
+/*                 ̳߳                   */
+/*                                          */
+/*                                          */
+
+//̶ĿĹ߳ȡִУʱȶеִٽ߳
+class ThreadPool {
+public:
+    ThreadPool(int thread_num);
+    ThreadPool(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    int size() const { return (int)workers.size(); }
+private:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable ready;
+    bool stopping;
+};
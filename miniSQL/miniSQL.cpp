@@ -8,14 +8,53 @@ extern void BufferManager_test();
 extern void BPlusTree_test();
 extern void IndexManager_test();
 extern void API_test();
-extern void Interpreter_test();
+extern void Recovery_test();
+extern void Interpreter_test(size_t pool_size, ReplacePolicy policy, const FlushConfig &config, bool mapped_reads);
+extern void Server_start(size_t pool_size, ReplacePolicy policy, int port, const FlushConfig &config, bool mapped_reads);
 
-int main()
+int main(int argc, char *argv[])
 {
+    size_t pool_size = DEFAULT_POOL_SIZE;
+    ReplacePolicy policy = ReplacePolicy::CLOCK;
+    int port = 0;//非0时以服务模式运行
+    FlushConfig config;
+    bool mapped_reads = false;//只读取页时直接读文件映射
+    bool recovery_test = false;//只运行恢复测试
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg.compare(0, 14, "--buffer-pool=") == 0) pool_size = parseByteSize(arg.substr(14));
+            else if (arg == "--replacer=clock") policy = ReplacePolicy::CLOCK;
+            else if (arg == "--replacer=lru2") policy = ReplacePolicy::LRU_2;
+            else if (arg == "--mmap") mapped_reads = true;
+            else if (arg == "--recovery-test") recovery_test = true;
+            else if (arg.compare(0, 9, "--server=") == 0) {
+                port = atoi(arg.substr(9).c_str());
+                if (port <= 0 || port > 65535) throw MiniSQLException("Illegal Port: " + arg.substr(9));
+            }
+            else if (arg.compare(0, 14, "--writer-rate=") == 0) config.writer_rate = atoi(arg.substr(14).c_str());
+            else if (arg.compare(0, 18, "--checkpoint-rate=") == 0) config.checkpoint_rate = atoi(arg.substr(18).c_str());
+            else if (arg.compare(0, 22, "--checkpoint-interval=") == 0) config.checkpoint_interval = atoi(arg.substr(22).c_str());
+            else if (arg.compare(0, 17, "--checkpoint-log=") == 0) config.checkpoint_log_size = parseByteSize(arg.substr(17));
+            else throw MiniSQLException("Unknown Option: " + arg);
+        }
+    } catch (MiniSQLException &e) {
+        cout << e.getMessage() << endl;
+        return 1;
+    }
+
+
     //Meta_test();
     //BPlusTree_test();
     //IndexManager_test();
     //BufferManager_test();
     //API_test();
-    Interpreter_test();
+    try {
+        if (recovery_test) Recovery_test();
+        else if (port != 0) Server_start(pool_size, policy, port, config, mapped_reads);
+        else Interpreter_test(pool_size, policy, config, mapped_reads);
+    } catch (MiniSQLException &e) {
+        cout << e.getMessage() << endl;
+        return 1;
+    }
 }
\ No newline at end of file